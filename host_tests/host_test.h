@@ -0,0 +1,26 @@
+// Minimal checks of the host tests, a failed check is printed and the
+// test goes on, the exit code tells if any check has failed.
+#ifndef _HOST_TEST_H
+#define _HOST_TEST_H
+
+#include <stdio.h>
+
+static int s_failed_checks = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        s_failed_checks += 1; \
+        printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while (0)
+
+static inline int host_test_result(const char *name)
+{
+    printf("%s: %s\n", name, s_failed_checks ? "FAILED" : "passed");
+    return s_failed_checks ? 1 : 0;
+}
+
+// _HOST_TEST_H
+#endif
@@ -0,0 +1,18 @@
+// Host stand-in of the SDK clocks, the system clock is the default 125MHz.
+#ifndef _STUB_HARDWARE_CLOCKS_H
+#define _STUB_HARDWARE_CLOCKS_H
+
+#include "pico/stdlib.h"
+
+enum clock_index { clk_sys };
+
+#define STUB_CLOCK_HZ 125000000u
+
+static inline uint32_t clock_get_hz(enum clock_index clk_index)
+{
+    (void)clk_index;
+    return STUB_CLOCK_HZ;
+}
+
+// _STUB_HARDWARE_CLOCKS_H
+#endif
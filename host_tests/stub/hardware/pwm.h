@@ -0,0 +1,39 @@
+// Host stand-in of the SDK slice configuration, the values are only stored.
+#ifndef _STUB_HARDWARE_PWM_H
+#define _STUB_HARDWARE_PWM_H
+
+#include "pico/stdlib.h"
+
+typedef struct
+{
+    bool phase_correct;
+    uint16_t top;
+    uint8_t div_int;
+    uint8_t div_frac;
+} pwm_config;
+
+static inline void pwm_config_set_phase_correct(pwm_config *c, bool phase_correct)
+{
+    c->phase_correct = phase_correct;
+}
+
+static inline void pwm_config_set_wrap(pwm_config *c, uint16_t wrap)
+{
+    c->top = wrap;
+}
+
+static inline void pwm_config_set_clkdiv_int_frac(pwm_config *c, uint8_t integer, uint8_t fract)
+{
+    c->div_int = integer;
+    c->div_frac = fract;
+}
+
+static inline void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract)
+{
+    (void)slice_num;
+    (void)integer;
+    (void)fract;
+}
+
+// _STUB_HARDWARE_PWM_H
+#endif
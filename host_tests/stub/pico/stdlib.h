@@ -0,0 +1,21 @@
+// Host stand-in of the SDK types and macros the tested code uses.
+#ifndef _STUB_PICO_STDLIB_H
+#define _STUB_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#ifndef MIN
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+// _STUB_PICO_STDLIB_H
+#endif
@@ -0,0 +1,178 @@
+//
+// Key state machine and event queue of lib_input on synthetic traces of
+// a key pin. The pin is sampled every millisecond like the tick alarm
+// does, an edge of the trace restarts the debounce like the GPIO IRQ. A
+// bouncing press or release must give one event once the pin is stable
+// for the debounce time, a short glitch none, a held key the repeats at
+// the autorepeat delays, and a full queue must count the lost events.
+// SL (2025)
+//
+#include "input_keys.h"
+#include "host_test.h"
+
+#define RELEASED true
+#define PRESSED false
+#define MAX_TRACE_MS 2000
+
+typedef struct {
+    input_key_t key;
+    input_queue_t queue;
+    bool value;
+    bool ticking;
+    uint32_t now;
+    uint32_t last_edge_ms;
+} rig_t;
+
+static void rig_init(rig_t *rig, bool autorepeat, uint32_t start_ms)
+{
+    *rig = (rig_t){ 0 };
+    input_key_init(&rig->key, 0, 7, RELEASED, autorepeat);
+    rig->value = RELEASED;
+    rig->now = start_ms;
+}
+
+// Runs one millisecond with the pin at the value, ticks only while the
+// key asks for them as input.c does.
+static void rig_step(rig_t *rig, bool value)
+{
+    if (value != rig->value) {
+        rig->value = value;
+        input_key_on_edge(&rig->key, rig->now);
+        rig->last_edge_ms = rig->now;
+        rig->ticking = true;
+    }
+    if (rig->ticking) rig->ticking = input_key_on_tick(&rig->key, &rig->queue, rig->value, rig->now);
+    rig->now += 1;
+}
+
+static void rig_hold(rig_t *rig, bool value, uint ms)
+{
+    for (uint i = 0; i < ms; i++) rig_step(rig, value);
+}
+
+// Toggles the pin every millisecond, ends at the given value.
+static void rig_bounce(rig_t *rig, uint toggles, bool final_value)
+{
+    for (uint i = 0; i <= toggles; i++) rig_step(rig, (i % 2 == 0) ? final_value : !final_value);
+}
+
+static int take_events(rig_t *rig, input_event_t *events, int max_events)
+{
+    int count = 0;
+    while (count < max_events && input_queue_pop(&rig->queue, &events[count])) count++;
+    return count;
+}
+
+static void check_bounce(uint32_t start_ms)
+{
+    rig_t rig;
+    rig_init(&rig, false, start_ms);
+    input_event_t events[8];
+
+    rig_hold(&rig, RELEASED, 5);
+    rig_bounce(&rig, 6, PRESSED);
+    uint32_t stable_ms = rig.last_edge_ms;
+    rig_hold(&rig, PRESSED, 100);
+
+    int count = take_events(&rig, events, 8);
+    CHECK(count == 1 && events[0].type == INPUT_KEY_DOWN && events[0].key == 7,
+        "start %u: bouncing press gives %d events", start_ms, count);
+    CHECK(count < 1 || events[0].time_ms == stable_ms + INPUT_DEBOUNCE_MS,
+        "start %u: press at %u, stable from %u", start_ms, events[0].time_ms, stable_ms);
+    CHECK(!rig.ticking, "start %u: key without autorepeat keeps ticking", start_ms);
+
+    rig_bounce(&rig, 4, RELEASED);
+    rig_hold(&rig, RELEASED, 100);
+    count = take_events(&rig, events, 8);
+    CHECK(count == 1 && events[0].type == INPUT_KEY_UP, "start %u: bouncing release gives %d events",
+        start_ms, count);
+    CHECK(!rig.ticking, "start %u: released key keeps ticking", start_ms);
+}
+
+static void check_glitch()
+{
+    rig_t rig;
+    rig_init(&rig, true, 0);
+    input_event_t events[8];
+
+    // released key, a glitch shorter than the debounce
+    rig_hold(&rig, PRESSED, INPUT_DEBOUNCE_MS / 2);
+    rig_hold(&rig, RELEASED, 50);
+    CHECK(take_events(&rig, events, 8) == 0, "glitch of a released key");
+
+    // held key, a release glitch neither releases it nor stops the repeats
+    rig_hold(&rig, PRESSED, 200);
+    rig_hold(&rig, RELEASED, 2);
+    rig_hold(&rig, PRESSED, 400);
+    int count = take_events(&rig, events, 8);
+    CHECK(count >= 2 && events[0].type == INPUT_KEY_DOWN, "held key gives %d events", count);
+    for (int i = 1; i < count; i++) {
+        CHECK(events[i].type == INPUT_KEY_REPEAT, "event %d of held key is %u", i, events[i].type);
+    }
+    CHECK(rig.ticking, "held key stops ticking after a glitch");
+}
+
+static void check_autorepeat()
+{
+    rig_t rig;
+    rig_init(&rig, true, 0);
+    input_event_t events[INPUT_QUEUE_SIZE];
+
+    const uint hold_ms = 1000;
+    rig_hold(&rig, PRESSED, hold_ms);
+    int count = take_events(&rig, events, INPUT_QUEUE_SIZE);
+
+    // the press is seen after the debounce, the repeats follow it
+    uint32_t down_ms = INPUT_DEBOUNCE_MS;
+    uint repeats = (hold_ms - 1 - down_ms - INPUT_FIRST_REPEAT_MS) / INPUT_LATER_REPEAT_MS + 1;
+    CHECK(count == (int)(1 + repeats), "%d events, %u repeats expected", count, repeats);
+    CHECK(events[0].type == INPUT_KEY_DOWN && events[0].time_ms == down_ms, "press at %u", events[0].time_ms);
+    for (int i = 1; i < count; i++) {
+        uint32_t expected = down_ms + INPUT_FIRST_REPEAT_MS + (i - 1) * INPUT_LATER_REPEAT_MS;
+        CHECK(events[i].type == INPUT_KEY_REPEAT && events[i].time_ms == expected,
+            "repeat %d at %u, expected %u", i, events[i].time_ms, expected);
+    }
+
+    rig_hold(&rig, RELEASED, 50);
+    count = take_events(&rig, events, INPUT_QUEUE_SIZE);
+    CHECK(count == 1 && events[0].type == INPUT_KEY_UP, "release of held key gives %d events", count);
+    CHECK(!rig.ticking, "released key keeps ticking");
+}
+
+static void check_queue_overflow()
+{
+    input_queue_t queue = { 0 };
+    const int pushed = INPUT_QUEUE_SIZE + 8;
+    for (int i = 0; i < pushed; i++) input_queue_push(&queue, (uint8_t)i, INPUT_KEY_DOWN, (uint32_t)i);
+    CHECK(queue.lost_events == 8, "lost %u events", queue.lost_events);
+
+    // the oldest events are kept in order, a freed slot takes a new one
+    input_event_t event;
+    CHECK(input_queue_pop(&queue, &event) && event.key == 0, "first event %u", event.key);
+    input_queue_push(&queue, 200, INPUT_KEY_UP, 200);
+    CHECK(queue.lost_events == 8, "freed slot lost an event");
+
+    int count = 1;
+    uint8_t last = 0;
+    bool ordered = true;
+    while (input_queue_pop(&queue, &event)) {
+        if (event.key != 200 && event.key != last + 1) ordered = false;
+        last = event.key;
+        count += 1;
+    }
+    CHECK(count == INPUT_QUEUE_SIZE + 1, "%d events taken", count);
+    CHECK(ordered && last == 200, "events out of order, last %u", last);
+}
+
+int main()
+{
+    check_bounce(0);
+
+    // the deadlines survive the 32-bit millisecond wrap
+    check_bounce(UINT32_MAX - 20);
+
+    check_glitch();
+    check_autorepeat();
+    check_queue_overflow();
+    return host_test_result("input");
+}
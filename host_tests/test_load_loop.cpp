@@ -0,0 +1,241 @@
+//
+// Runs the pico_load control loop on a simulated plant: the DAC drives
+// the MOSFET gate through the op-amp with a lag, the MOSFET current is
+// square law above its threshold and limited by the source, which has
+// an internal resistance. The ADC samples are quantized with noise and
+// the DAC value the loop writes is taken at the next control period, as
+// with the sequencer frame. The loop must settle the steps without
+// overshoot or ringing in all modes and for plants of different gain,
+// and must come out of saturation without windup.
+// SL (2025)
+//
+#include <math.h>
+#include "board_config.h"
+#include "dac_mcp4921.h"
+#include "load_loop.h"
+#include "host_test.h"
+
+#define SUBSTEPS 10             // plant steps per control period
+#define GATE_LAG_US 30.0
+#define SAMPLES_PER_TICK 5
+#define ADC_CODES 4095.0
+
+typedef struct
+{
+    // plant
+    double gain;            // mA per DAC value squared above the threshold
+    double threshold;       // DAC value of the MOSFET threshold
+    double source_mv;
+    double source_mohm;
+    double gate;            // DAC value seen by the gate after the lag
+    double current_ma;
+
+    // loop
+    load_mode_t mode;
+    int32_t target;
+    int32_t setpoint_ma;
+    uint16_t dac_value;     // written by the loop
+    uint16_t applied_dac;   // taken at the next period
+    load_loop_t loop;
+    uint32_t noise_state;
+} sim_t;
+
+static void sim_init(sim_t *sim, double gain_scale, double threshold, double source_mv, double source_mohm)
+{
+    *sim = {};
+    sim->gain = gain_scale * 4000.0 / ((4095.0 - threshold) * (4095.0 - threshold));
+    sim->threshold = threshold;
+    sim->source_mv = source_mv;
+    sim->source_mohm = source_mohm;
+    sim->noise_state = 1;
+    load_loop_reset(&sim->loop);
+}
+
+static double voltage_mv(const sim_t *sim)
+{
+    return sim->source_mv - sim->current_ma * sim->source_mohm / 1000;
+}
+
+// noise of -1, 0 or +1 ADC code
+static int next_noise(sim_t *sim)
+{
+    sim->noise_state = sim->noise_state * 1664525u + 1013904223u;
+    return (int)((sim->noise_state >> 16) % 3) - 1;
+}
+
+static int32_t measure(sim_t *sim, double value, double full_scale)
+{
+    double code = round(value / full_scale * ADC_CODES) + next_noise(sim);
+    code = fmin(ADC_CODES, fmax(0, code));
+    return (int32_t)code;
+}
+
+static void plant_step(sim_t *sim, double dt_us)
+{
+    sim->gate += (sim->applied_dac - sim->gate) * (1 - exp(-dt_us / GATE_LAG_US));
+    double overdrive = fmax(0, sim->gate - sim->threshold);
+    double saturation_ma = sim->gain * overdrive * overdrive;
+
+    // the MOSFET can't take more than the source gives into a short
+    double short_ma = sim->source_mv * 1000 / (sim->source_mohm + 50);
+    sim->current_ma = fmin(saturation_ma, short_ma);
+}
+
+// One control period, the loop sees the mean of the samples like take_samples().
+static void sim_tick(sim_t *sim)
+{
+    sim->applied_dac = sim->dac_value;
+
+    int32_t current_sum = 0;
+    int32_t voltage_sum = 0;
+    for (int i = 0; i < SUBSTEPS; i++) {
+        plant_step(sim, LOAD_CONTROL_PERIOD_US / (double)SUBSTEPS);
+        if (i % (SUBSTEPS / SAMPLES_PER_TICK) == 0) {
+            current_sum += measure(sim, sim->current_ma, LOAD_CURRENT_FULL_SCALE_MA);
+            voltage_sum += measure(sim, voltage_mv(sim), LOAD_VOLTAGE_FULL_SCALE_MV);
+        }
+    }
+
+    int32_t current_ma = current_sum / SAMPLES_PER_TICK * LOAD_CURRENT_FULL_SCALE_MA / (int32_t)ADC_CODES;
+    int32_t measured_mv = voltage_sum / SAMPLES_PER_TICK * LOAD_VOLTAGE_FULL_SCALE_MV / (int32_t)ADC_CODES;
+
+    int32_t demand = load_loop_demand_ma(sim->mode, sim->target, measured_mv);
+    sim->setpoint_ma = load_loop_slew(sim->setpoint_ma, demand);
+    sim->dac_value = load_loop_step(&sim->loop, sim->setpoint_ma, current_ma);
+}
+
+typedef struct
+{
+    double max_ma;
+    double min_ma;
+    double final_ma;
+    double ripple_ma;   // standard deviation of the last 100 periods
+    int settled_tick;   // first period from which it stays within the band
+} response_t;
+
+static void run(sim_t *sim, int ticks, double expected_ma, double band_ma, response_t *response)
+{
+    response->max_ma = -1e9;
+    response->min_ma = 1e9;
+    response->settled_tick = -1;
+
+    double sum = 0, sum_squares = 0;
+    for (int i = 0; i < ticks; i++) {
+        sim_tick(sim);
+        double ma = sim->current_ma;
+        response->max_ma = fmax(response->max_ma, ma);
+        response->min_ma = fmin(response->min_ma, ma);
+
+        bool within = fabs(ma - expected_ma) <= band_ma;
+        if (!within) response->settled_tick = -1;
+        else if (response->settled_tick < 0) response->settled_tick = i;
+
+        if (i >= ticks - 100) {
+            sum += ma;
+            sum_squares += ma * ma;
+        }
+    }
+
+    response->final_ma = sim->current_ma;
+    double mean = sum / 100;
+    response->ripple_ma = sqrt(fmax(0, sum_squares / 100 - mean * mean));
+}
+
+// Current step in CC mode, the setpoint ramps at 50mA per ms and the
+// current must settle within 20ms of the end of the ramp. The gain
+// scale is of MOSFETs that take at least the full current at the top
+// of the DAC.
+static void check_cc_step(double gain_scale, double threshold, int32_t from_ma, int32_t to_ma)
+{
+    sim_t sim;
+    sim_init(&sim, gain_scale, threshold, 12000, 100);
+    sim.mode = LOAD_MODE_CC;
+    sim.target = from_ma;
+
+    response_t response;
+    run(&sim, 1000, from_ma, 20, &response);
+    CHECK(fabs(response.final_ma - from_ma) <= 20, "gain x%.1f start %d mA got %.0f", gain_scale, from_ma, response.final_ma);
+
+    sim.target = to_ma;
+    int ramp_ticks = abs(to_ma - from_ma) / 5;
+    run(&sim, ramp_ticks + 1000, to_ma, 20, &response);
+
+    double overshoot = (to_ma > from_ma) ? response.max_ma - to_ma : to_ma - response.min_ma;
+    CHECK(overshoot <= 0.03 * abs(to_ma - from_ma) + 20,
+        "gain x%.1f step %d->%d overshoot %.0f mA", gain_scale, from_ma, to_ma, overshoot);
+    CHECK(response.settled_tick >= 0 && response.settled_tick <= ramp_ticks + 200,
+        "gain x%.1f step %d->%d settled at %d, ramp %d", gain_scale, from_ma, to_ma,
+        response.settled_tick, ramp_ticks);
+    CHECK(response.ripple_ma <= 5, "gain x%.1f step %d->%d ripple %.1f mA",
+        gain_scale, from_ma, to_ma, response.ripple_ma);
+}
+
+// The source can't give the setpoint, the loop saturates, then the
+// setpoint comes down into reach and the loop must follow it at once.
+static void check_windup()
+{
+    sim_t sim;
+    sim_init(&sim, 1, 1000, 2000, 1000);
+    sim.mode = LOAD_MODE_CC;
+    sim.target = 3000;
+
+    response_t response;
+    run(&sim, 2000, 3000, 20, &response);
+    CHECK(response.max_ma < 2000, "saturated at %.0f mA", response.max_ma);
+    CHECK(sim.dac_value == MCP4921_MAX_VALUE, "saturated DAC %u", sim.dac_value);
+
+    // setpoint comes down at the slew rate from the 3000mA it has reached
+    sim.target = 1000;
+    run(&sim, 400 + 200, 1000, 20, &response);
+    CHECK(response.settled_tick >= 0 && response.settled_tick <= 400 + 100,
+        "recovered from saturation at %d", response.settled_tick);
+    CHECK(response.min_ma >= 1000 - 30, "undershoot after saturation %.0f mA", response.min_ma);
+}
+
+static void check_cr()
+{
+    sim_t sim;
+    sim_init(&sim, 1, 1000, 12000, 500);
+    sim.mode = LOAD_MODE_CR;
+    sim.target = 10000; // mOhm
+
+    double expected_ma = 12000.0 / (10000 + 500) * 1000;
+    response_t response;
+    run(&sim, 2000, expected_ma, 20, &response);
+    double ohms = voltage_mv(&sim) / sim.current_ma;
+    CHECK(fabs(ohms - 10) <= 0.2, "CR 10 ohm got %.2f ohm at %.0f mA", ohms, sim.current_ma);
+    CHECK(response.ripple_ma <= 5, "CR ripple %.1f mA", response.ripple_ma);
+}
+
+static void check_cp()
+{
+    sim_t sim;
+    sim_init(&sim, 1, 1000, 12000, 500);
+    sim.mode = LOAD_MODE_CP;
+    sim.target = 6000; // mW
+
+    response_t response;
+    run(&sim, 2000, 0, 1e9, &response);
+    double mw = voltage_mv(&sim) * sim.current_ma / 1000;
+    CHECK(fabs(mw - 6000) <= 120, "CP 6W got %.0f mW", mw);
+    CHECK(response.ripple_ma <= 5, "CP ripple %.1f mA", response.ripple_ma);
+
+    // no power demand from a disconnected input
+    CHECK(load_loop_demand_ma(LOAD_MODE_CP, 6000, 100) == 0, "CP at 100 mV");
+    CHECK(load_loop_demand_ma(LOAD_MODE_CC, 5000, 0) == LOAD_MAX_CURRENT_MA, "CC limit");
+}
+
+int main()
+{
+    const double gain_scales[] = { 1, 2, 4 };
+    for (double scale : gain_scales) {
+        check_cc_step(scale, 1000, 0, 1000);
+        check_cc_step(scale, 1000, 2500, 500);
+        check_cc_step(scale, 1800, 200, 2800);
+    }
+
+    check_windup();
+    check_cr();
+    check_cp();
+    return host_test_result("load_loop");
+}
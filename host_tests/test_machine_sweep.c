@@ -0,0 +1,109 @@
+//
+// Runs the SWEEP points and statistics of pico_machine against a host
+// stand-in of the PWM and the ADC: an LC tank of known resonance and Q
+// gives one period of a sine with a little noise for each frequency.
+// The sweep must find the resonance and the statistics must match the
+// amplitude of the tank.
+// SL (2025)
+//
+#include <math.h>
+#include <stdlib.h>
+#include "machine_sweep.h"
+#include "host_test.h"
+
+#define FRAME_SAMPLES 100
+#define ADC_MEAN 128
+
+#define TANK_HZ 25000
+#define TANK_Q 20
+#define TANK_AMPLITUDE 100
+
+static uint32_t s_noise_state = 1;
+
+// noise of -1, 0 or +1 ADC unit
+static int next_noise()
+{
+    s_noise_state = s_noise_state * 1664525u + 1013904223u;
+    return (int)((s_noise_state >> 16) % 3) - 1;
+}
+
+static double tank_amplitude(uint hz)
+{
+    double detune = (double)hz / TANK_HZ - (double)TANK_HZ / hz;
+    return TANK_AMPLITUDE / sqrt(1 + TANK_Q * TANK_Q * detune * detune);
+}
+
+// One PWM period of the tank voltage as the ADC records it.
+static uint measure_period(uint hz, uint8_t *buffer)
+{
+    double amplitude = tank_amplitude(hz);
+    for (uint i = 0; i < FRAME_SAMPLES; i++) {
+        double value = ADC_MEAN + amplitude * sin(2 * M_PI * i / FRAME_SAMPLES) + next_noise();
+        buffer[i] = (uint8_t)fmin(255, fmax(0, round(value)));
+    }
+    return FRAME_SAMPLES;
+}
+
+static void check_points()
+{
+    CHECK(mach_sweep_count_points(1000, 1100, 10) == 11, "up");
+    CHECK(mach_sweep_count_points(1100, 1000, 10) == 11, "down");
+    CHECK(mach_sweep_count_points(1000, 1005, 10) == 1, "step above span");
+    CHECK(mach_sweep_point_hz(1000, 1100, 10, 10) == 1100, "last point up");
+    CHECK(mach_sweep_point_hz(1100, 1000, 10, 10) == 1000, "last point down");
+}
+
+static void check_stats()
+{
+    uint8_t frame[FRAME_SAMPLES];
+    mach_sweep_stats_t stats;
+
+    for (uint i = 0; i < FRAME_SAMPLES; i++) frame[i] = 77;
+    mach_sweep_compute_stats(frame, FRAME_SAMPLES, &stats);
+    CHECK(stats.rms10 == 0 && stats.peak == 0, "flat frame rms10 %u peak %u", stats.rms10, stats.peak);
+
+    for (uint i = 0; i < FRAME_SAMPLES; i++) frame[i] = (i % 2) ? 110 : 90;
+    mach_sweep_compute_stats(frame, FRAME_SAMPLES, &stats);
+    CHECK(stats.rms10 == 100 && stats.peak == 10, "square rms10 %u peak %u", stats.rms10, stats.peak);
+
+    mach_sweep_compute_stats(frame, 0, &stats);
+    CHECK(stats.rms10 == 0 && stats.peak == 0, "empty frame");
+}
+
+static void check_sweep(uint start_hz, uint stop_hz, uint step_hz)
+{
+    uint8_t frame[FRAME_SAMPLES];
+    uint best_hz = 0;
+    mach_sweep_stats_t best = { 0, 0 };
+
+    uint num_points = mach_sweep_count_points(start_hz, stop_hz, step_hz);
+    for (uint i = 0; i < num_points; i++) {
+        uint hz = mach_sweep_point_hz(start_hz, stop_hz, step_hz, i);
+        uint num_samples = measure_period(hz, frame);
+
+        mach_sweep_stats_t stats;
+        mach_sweep_compute_stats(frame, num_samples, &stats);
+
+        double expected_rms10 = 10 * tank_amplitude(hz) / sqrt(2);
+        CHECK(fabs(stats.rms10 - expected_rms10) <= 10, "%u Hz rms10 %u expected %.0f",
+            hz, stats.rms10, expected_rms10);
+        // peak takes the noise, the rounding and the integer mean
+        CHECK(fabs(stats.peak - tank_amplitude(hz)) <= 3, "%u Hz peak %u", hz, stats.peak);
+
+        if (stats.rms10 > best.rms10) {
+            best = stats;
+            best_hz = hz;
+        }
+    }
+
+    CHECK(abs((int)best_hz - TANK_HZ) <= (int)step_hz, "resonance found at %u Hz", best_hz);
+}
+
+int main()
+{
+    check_points();
+    check_stats();
+    check_sweep(20000, 30000, 100);
+    check_sweep(30000, 20000, 50);
+    return host_test_result("machine_sweep");
+}
@@ -0,0 +1,139 @@
+//
+// Runs the resonance tracking loop of pico_machine on a simulated LC
+// tank. The tank resonance moves with its capacitance, the sense code
+// reports the tank periods of each 1ms loop step with some jitter and
+// a new top takes effect one step later, as with the DMA reload. The
+// loop must lock from a start off the resonance, stay locked through a
+// slow drift and lock again after a step of the load.
+// SL (2025)
+//
+#include <math.h>
+#include <stdlib.h>
+#include "machine_track.h"
+#include "host_test.h"
+
+#define CLOCK_HZ 125000000.0
+#define STEP_S 0.001
+#define WAVES 2
+#define DIV16 16
+
+#define TANK_L 100e-6
+#define LOCK_STEPS 300
+
+typedef struct
+{
+    double capacitance;
+    uint16_t top;           // top the drive runs with
+    uint16_t pending_top;   // top which is applied at the next step
+    mach_track_t track;
+    uint32_t noise_state;
+} sim_t;
+
+static double tank_hz(const sim_t *sim)
+{
+    return 1 / (2 * M_PI * sqrt(TANK_L * sim->capacitance));
+}
+
+// relative jitter of the sum up to +-1e-5
+static double next_jitter(sim_t *sim)
+{
+    sim->noise_state = sim->noise_state * 1664525u + 1013904223u;
+    return ((double)(sim->noise_state >> 8) / (1 << 24) - 0.5) * 2e-5;
+}
+
+// Top which makes the drive period WAVES tank periods long.
+static double ideal_top(const sim_t *sim)
+{
+    return CLOCK_HZ * 16 * WAVES / (tank_hz(sim) * DIV16) - 1;
+}
+
+static void sim_start(sim_t *sim, double capacitance, double drive_hz, int kp, int ki)
+{
+    sim->capacitance = capacitance;
+    sim->top = (uint16_t)(CLOCK_HZ * 16 / (drive_hz * DIV16) - 1);
+    sim->pending_top = sim->top;
+    sim->track.kp = kp;
+    sim->track.ki = ki;
+    sim->noise_state = 1;
+    mach_track_reset(&sim->track, sim->top);
+}
+
+static void sim_step(sim_t *sim)
+{
+    sim->top = sim->pending_top;
+
+    double hz = tank_hz(sim);
+    uint periods = (uint)(hz * STEP_S);
+    uint64_t sum_clocks = (uint64_t)(periods * CLOCK_HZ / hz * (1 + next_jitter(sim)));
+    sim->pending_top = mach_track_step(&sim->track, sum_clocks, periods, WAVES, DIV16, sim->top);
+}
+
+// Runs until the loop is locked, returns the steps it took or -1.
+static int run_until_locked(sim_t *sim, int max_steps)
+{
+    for (int i = 0; i < max_steps; i++) {
+        sim_step(sim);
+        if (mach_track_is_locked(&sim->track)) return i + 1;
+    }
+    return -1;
+}
+
+static void check_lock(int kp, int ki)
+{
+    sim_t sim;
+
+    // tank is 10% above the drive
+    double capacitance = 150e-9;
+    double start_hz = 1 / (2 * M_PI * sqrt(TANK_L * capacitance)) / WAVES / 1.1;
+    sim_start(&sim, capacitance, start_hz, kp, ki);
+
+    int steps = run_until_locked(&sim, LOCK_STEPS);
+    CHECK(steps > 0, "kp %d ki %d lock from 10%% off", kp, ki);
+    CHECK(fabs(sim.top - ideal_top(&sim)) <= 2 + sim.top / 256.0,
+        "kp %d ki %d top %u ideal %.1f", kp, ki, sim.top, ideal_top(&sim));
+
+    // temperature drift: the capacitance goes up 5% in 2 seconds
+    int unlocked = 0;
+    double max_error = 0;
+    for (int i = 0; i < 2000; i++) {
+        sim.capacitance *= 1 + 0.05 / 2000;
+        sim_step(&sim);
+        if (!mach_track_is_locked(&sim.track)) unlocked += 1;
+        max_error = fmax(max_error, fabs(sim.top - ideal_top(&sim)) / ideal_top(&sim));
+    }
+    CHECK(unlocked == 0, "kp %d ki %d unlocked %d steps during the drift", kp, ki, unlocked);
+    CHECK(max_error < 0.005, "kp %d ki %d drift error %g", kp, ki, max_error);
+
+    // load step: the resonance drops 3% at once
+    sim.capacitance *= 1.0609;
+    sim_step(&sim);
+    CHECK(!mach_track_is_locked(&sim.track), "kp %d ki %d unlocked by the load step", kp, ki);
+    steps = run_until_locked(&sim, LOCK_STEPS);
+    CHECK(steps > 0, "kp %d ki %d lock after the load step", kp, ki);
+    CHECK(fabs(sim.top - ideal_top(&sim)) <= 2 + sim.top / 256.0,
+        "kp %d ki %d top %u ideal %.1f after the load step", kp, ki, sim.top, ideal_top(&sim));
+}
+
+// Resonance out of the tracking range keeps the top at the range limit.
+static void check_range_limit()
+{
+    sim_t sim;
+    sim_start(&sim, 150e-9, 10000, 64, 8);
+    sim.capacitance *= 9;   // resonance drops to a third
+    for (int i = 0; i < 2000; i++) sim_step(&sim);
+
+    CHECK(!mach_track_is_locked(&sim.track), "out of range is not locked");
+    CHECK(sim.top <= sim.track.base_top * 2, "top %u within twice the base", sim.top);
+}
+
+int main()
+{
+    const int kp_values[] = { 32, 64, 128 };
+    const int ki_values[] = { 4, 8, 16 };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) check_lock(kp_values[i], ki_values[j]);
+    }
+
+    check_range_limit();
+    return host_test_result("machine_track");
+}
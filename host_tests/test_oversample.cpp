@@ -0,0 +1,119 @@
+//
+// Effective bits of the oversampling stage on synthetic ADC samples of
+// a steady current between the codes. The setpoint dither is held for a
+// control period of 4 or 5 samples and the current follows it with the
+// lag of the loop, so the decimation window is not a whole number of
+// dither steps. Without the dither every sample of a steady input is the
+// same code and averaging gains nothing.
+// SL (2025)
+//
+#include <math.h>
+#include "oversample.h"
+#include "host_test.h"
+
+#define INPUTS 1000
+#define FULL_SCALE_CODES 4095.0
+#define MA_PER_CODE (3300.0 / 4095.0)
+#define DITHER_MA 3
+#define LOOP_LAG_PERIODS 2.0
+
+// samples per control period alternate to make the mean of 4.5, the
+// sequencer gives about 4.7 pairs per period
+#define SAMPLES_PER_PERIOD_MEAN 4.5
+static const int s_samples_per_period[2] = { 4, 5 };
+
+// Returns the effective bits of the outputs against the exact inputs,
+// 12 bits is the RMS error of the plain quantization, 1/sqrt(12) LSB.
+static double measure_effective_bits(uint ratio, bool dither)
+{
+    uint32_t input_state = 12345;
+    double follow = 1 - exp(-1 / (SAMPLES_PER_PERIOD_MEAN * LOOP_LAG_PERIODS));
+    double sum_squares = 0;
+    int outputs = 0;
+
+    for (int n = 0; n < INPUTS; n++) {
+        input_state = input_state * 1664525u + 1013904223u;
+        double input = 100 + (input_state >> 8) % 3800000 / 1000.0;
+
+        oversample_t os;
+        oversample_init(&os, ratio);
+
+        // the first output is of the settling current, it is not counted
+        int period = n & 1;
+        int held = s_samples_per_period[period];
+        double setpoint = 0;
+        double offset = 0;
+        for (uint i = 0; i < 4 * ratio; i++) {
+            if (held == s_samples_per_period[period]) {
+                period ^= 1;
+                held = 0;
+                if (dither) setpoint = oversample_dither(&os, DITHER_MA) / MA_PER_CODE;
+            }
+            held += 1;
+            offset += (setpoint - offset) * follow;
+
+            double code = fmin(FULL_SCALE_CODES, fmax(0, round(input + offset)));
+            if (oversample_add(&os, (uint16_t)code) && os.outputs > 1) {
+                double error = os.value / 16.0 - input;
+                sum_squares += error * error;
+                outputs += 1;
+            }
+        }
+    }
+
+    double rms = sqrt(sum_squares / outputs);
+    return OVERSAMPLE_ADC_BITS - log2(rms * sqrt(12.0));
+}
+
+// The dither must not move the outputs, its sum over a window is zero.
+static void check_dither_mean()
+{
+    for (uint ratio = 1; ratio <= OVERSAMPLE_MAX_RATIO; ratio *= 2) {
+        oversample_t os;
+        oversample_init(&os, ratio);
+
+        int32_t sum = 0;
+        int32_t max = 0;
+        do {
+            int32_t dither = oversample_dither(&os, DITHER_MA);
+            sum += dither;
+            max = MAX(max, dither);
+        } while (!oversample_add(&os, 0));
+
+        CHECK(sum == 0, "%ux dither sum %d", ratio, sum);
+        if (ratio < OVERSAMPLE_DITHER_MIN_RATIO) CHECK(max == 0, "%ux dither is on", ratio);
+        else CHECK(max == DITHER_MA, "%ux dither peak %d", ratio, max);
+    }
+}
+
+int main()
+{
+    check_dither_mean();
+
+    double plain = measure_effective_bits(1, false);
+    CHECK(fabs(plain - 12) < 0.1, "1x %.2f bits", plain);
+
+    double steady = measure_effective_bits(256, false);
+    CHECK(steady < 12.2, "256x without dither %.2f bits", steady);
+
+    double bits64 = measure_effective_bits(64, true);
+    CHECK(bits64 > 14, "64x with dither %.2f bits", bits64);
+
+    double bits256 = measure_effective_bits(256, true);
+    CHECK(bits256 > 14.5, "256x with dither %.2f bits", bits256);
+
+    // the bits the load reports are never more than measured
+    for (uint ratio = 1; ratio <= OVERSAMPLE_MAX_RATIO; ratio *= 2) {
+        oversample_t os;
+        oversample_init(&os, ratio);
+        for (int dither = 0; dither < 2; dither++) {
+            double measured = measure_effective_bits(ratio, dither != 0);
+            uint reported = oversample_get_effective_bits(&os, dither != 0);
+            CHECK(measured > reported - 0.1, "%ux%s reports %u bits, measured %.2f",
+                ratio, dither ? " dither" : "", reported, measured);
+        }
+    }
+
+    printf("effective bits 1x %.2f, 256x %.2f, with dither 64x %.2f, 256x %.2f\n", plain, steady, bits64, bits256);
+    return host_test_result("oversample");
+}
@@ -0,0 +1,141 @@
+//
+// Sweeps the shared PWM top/divider solver from 10Hz to 1MHz in both
+// counter modes. Each timing must give back the frequency it reports,
+// be within half a count of the request, keep top above half range
+// whenever the frequency needs a divider above 1, and be as close as the
+// best divider of the same top range found by brute force. A top solved
+// for a fixed divider must keep it.
+// SL (2025)
+//
+#include <math.h>
+#include "hardware/clocks.h"
+#include "pwm_timing.h"
+#include "host_test.h"
+
+#define MIN_HZ 10
+#define MAX_HZ 1000000
+#define TOLERANCE_PPM 10
+
+static double produced_hz(const pwm_timing_t *timing)
+{
+    double slopes = timing->dual_slope ? 2 : 1;
+    return (double)STUB_CLOCK_HZ * 16 / ((double)timing->div16 * (timing->top + 1) * slopes);
+}
+
+static double relative_error(double hz, uint requested)
+{
+    return fabs(hz - requested) / requested;
+}
+
+// Lowest error of all the dividers which keep top above half of its
+// largest value, from the smallest divider which lets top fit to twice it.
+static double brute_force_error(uint hz, bool dual_slope)
+{
+    double best = INFINITY;
+    double slopes = dual_slope ? 2 : 1;
+    uint div_min = (uint)ceil((double)STUB_CLOCK_HZ * 16 / (65536 * slopes * hz));
+    div_min = MAX(div_min, 16u);
+    for (uint div16 = div_min; div16 <= MIN(2 * div_min, 4095u); div16++) {
+        double count = round((double)STUB_CLOCK_HZ * 16 / (div16 * slopes * hz));
+        if (count < 2 || count > 65536) continue;
+        double error = relative_error((double)STUB_CLOCK_HZ * 16 / (div16 * count * slopes), hz);
+        if (error < best) best = error;
+    }
+    return best;
+}
+
+static void check_timing(uint hz, bool dual_slope, bool compare_brute_force)
+{
+    pwm_timing_t timing;
+    bool ok = pwm_timing_solve(hz, dual_slope, &timing);
+    CHECK(ok, "%u Hz dual %d is in range", hz, dual_slope);
+    CHECK(timing.div16 >= 16 && timing.div16 <= 4095, "%u Hz div16 %u", hz, timing.div16);
+    CHECK(timing.dual_slope == dual_slope, "%u Hz mode", hz);
+
+    double produced = produced_hz(&timing);
+    CHECK(fabs(timing.hz - produced) <= produced * 1e-6,
+        "%u Hz reported %f produced %f", hz, timing.hz, produced);
+
+    double error = relative_error(produced, hz);
+    CHECK(error <= 0.5 / (timing.top + 1) + 1e-12, "%u Hz error %g top %u", hz, error, timing.top);
+
+    // below the frequency at which top fits with divider 1 the search
+    // starts from the smallest divider which lets top fit
+    double slopes = dual_slope ? 2 : 1;
+    if ((double)STUB_CLOCK_HZ / (65536 * slopes * hz) > 1) {
+        CHECK(timing.top >= 32000, "%u Hz top %u div16 %u", hz, timing.top, timing.div16);
+    }
+
+    if (compare_brute_force) {
+        double best = brute_force_error(hz, dual_slope);
+        CHECK(error <= fmax(best, TOLERANCE_PPM * 1e-6) + 1e-12,
+            "%u Hz error %g brute force %g", hz, error, best);
+    }
+
+    // the cached timing is the same
+    pwm_timing_t cached;
+    CHECK(pwm_timing_solve(hz, dual_slope, &cached) == ok &&
+        cached.top == timing.top && cached.div16 == timing.div16, "%u Hz cache", hz);
+}
+
+static void check_levels()
+{
+    pwm_timing_t timing;
+    pwm_timing_solve(20000, false, &timing);
+
+    CHECK(pwm_timing_level(&timing, 0) == 0, "zero duty");
+    CHECK(pwm_timing_level(&timing, 1) == timing.top + 1, "full duty");
+    CHECK(pwm_timing_level(&timing, 2) == timing.top + 1, "duty above 1");
+
+    uint16_t level = pwm_timing_level(&timing, 0.3f);
+    CHECK(fabs(pwm_timing_duty(&timing, level) - 0.3) <= 1.0 / (timing.top + 1),
+        "duty 0.3 level %u", level);
+}
+
+static void check_out_of_range()
+{
+    pwm_timing_t timing;
+    CHECK(!pwm_timing_solve(0, false, &timing), "0 Hz");
+    CHECK(!pwm_timing_solve(1, false, &timing), "1 Hz");
+    CHECK(timing.div16 == 4095 && timing.top == 65535, "1 Hz gets the slowest timing");
+    CHECK(!pwm_timing_solve(100000000, false, &timing), "100 MHz");
+    CHECK(timing.top == 1 && timing.div16 == 16, "100 MHz gets the fastest timing");
+}
+
+// A top for the running divider, as the phase shifted bridge legs take it.
+static void check_fixed_divider()
+{
+    pwm_timing_t running;
+    pwm_timing_solve(20000, true, &running);
+
+    pwm_timing_t timing;
+    CHECK(pwm_timing_solve_with_divider(25000, true, running.div16, &timing), "25 kHz");
+    CHECK(timing.div16 == running.div16, "divider %u kept", timing.div16);
+    CHECK(fabs(produced_hz(&timing) - timing.hz) <= timing.hz * 1e-6, "reported %f", timing.hz);
+    CHECK(relative_error(timing.hz, 25000) <= 0.5 / (timing.top + 1), "25 kHz top %u", timing.top);
+
+    // the top of this divider can't go low enough in frequency
+    CHECK(!pwm_timing_solve_with_divider(100, true, 16, &timing), "100 Hz at divider 1");
+    CHECK(timing.top == 65535, "100 Hz clamped top %u", timing.top);
+    CHECK(!pwm_timing_solve_with_divider(0, true, 16, &timing), "0 Hz");
+}
+
+int main()
+{
+    int points = 0;
+    for (int dual = 0; dual < 2; dual++) {
+        // about 100 points per decade, every 16th is compared to brute force
+        for (double hz = MIN_HZ; hz <= MAX_HZ; hz *= 1.0233) {
+            check_timing((uint)hz, dual != 0, points % 16 == 0);
+            points += 1;
+        }
+        check_timing(MAX_HZ, dual != 0, true);
+    }
+
+    check_levels();
+    check_out_of_range();
+    check_fixed_divider();
+
+    printf("%d frequencies\n", points);
+    return host_test_result("pwm_timing");
+}
@@ -0,0 +1,161 @@
+//
+// Encoder service. A repeating timer samples the quadrature PIO count at
+// a fixed rate, so the readers never touch the PIO FIFO. Velocity comes
+// from the time between count changes at low speed, where a change is
+// rarer than the sampling, and from the count difference over a window
+// at high speed. Fast spins make big steps for the values set by the
+// encoder, slow spins make single steps.
+// SL (2025)
+//
+#include <stdlib.h>
+#include <math.h>
+#include <pico/stdlib.h>
+#include <hardware/gpio.h>
+#include "quadrature.pio.h"
+#include "encoder_service.h"
+
+#define COUNT_MODE_1X 2
+#define COUNT_MODE_2X 1
+#define COUNT_MODE_4X 0
+
+#define SAMPLE_PERIOD_US 1000
+
+// count difference over 16ms is used once it is this many counts
+#define WINDOW_SAMPLES 16
+#define WINDOW_MIN_COUNTS 4
+
+// the encoder is at rest after no change for this long
+#define REST_US (500 * 1000)
+
+// step gains by speed in counts per second, a spin which is still
+// speeding up gets the gain of the next speed
+#define STEP_GAIN_LEVELS 4
+static const float s_gain_speeds[STEP_GAIN_LEVELS] = { 0, 8, 25, 60 };
+static const int s_gains[STEP_GAIN_LEVELS] = { 1, 5, 20, 50 };
+#define BOOST_ACCELERATION 200.0f
+
+static PIO s_encoder_pio;
+static int s_encoder_sm;
+static int s_encoder_count_mode;
+static repeating_timer_t s_timer;
+
+// written by the timer only
+static volatile int s_count;
+static volatile float s_velocity;
+static volatile float s_acceleration;
+static volatile int32_t s_step_total;
+
+static int s_count_window[WINDOW_SAMPLES];
+static float s_velocity_window[WINDOW_SAMPLES];
+static uint s_window_index;
+static uint64_t s_last_change_us;
+static uint32_t s_change_period_us;
+static int s_direction;
+
+// read by the reader only
+static int32_t s_steps_taken;
+
+static float compute_velocity(int delta, int window_delta, uint64_t now_us)
+{
+    // the changes are followed at any speed, so the low speed branch
+    // starts from the last change, not from one before a fast spin
+    if (delta != 0) {
+        if (s_last_change_us != 0) s_change_period_us = (uint32_t)(now_us - s_last_change_us) / abs(delta);
+        s_last_change_us = now_us;
+        s_direction = (delta > 0) ? 1 : -1;
+    }
+
+    // high speed, counts in the window are many enough for the difference
+    if (abs(window_delta) >= WINDOW_MIN_COUNTS) {
+        return window_delta * 1e6f / (WINDOW_SAMPLES * SAMPLE_PERIOD_US);
+    }
+
+    // low speed, one count per period between the changes, the velocity
+    // decays when the next change is later than the last period
+    uint64_t since_change_us = now_us - s_last_change_us;
+    if (s_change_period_us == 0 || since_change_us > REST_US) return 0;
+    uint32_t period_us = MAX(s_change_period_us, (uint32_t)since_change_us);
+    return s_direction * 1e6f / period_us;
+}
+
+static int compute_step_gain(float velocity, float acceleration)
+{
+    float speed = fabsf(velocity);
+    int level = 0;
+    while (level + 1 < STEP_GAIN_LEVELS && speed >= s_gain_speeds[level + 1]) level++;
+
+    bool speeding_up = velocity * acceleration > 0 && fabsf(acceleration) > BOOST_ACCELERATION;
+    if (speeding_up && level + 1 < STEP_GAIN_LEVELS) level++;
+    return s_gains[level];
+}
+
+static bool sample_encoder(repeating_timer_t *timer)
+{
+    int count = quadrature_encoder_get_count(s_encoder_pio, s_encoder_sm) >> s_encoder_count_mode;
+    int delta = count - s_count;
+
+    // window holds the samples of WINDOW_SAMPLES periods ago
+    int window_delta = count - s_count_window[s_window_index];
+    float velocity = compute_velocity(delta, window_delta, time_us_64());
+    float acceleration = (velocity - s_velocity_window[s_window_index]) *
+        1e6f / (WINDOW_SAMPLES * SAMPLE_PERIOD_US);
+
+    s_count_window[s_window_index] = count;
+    s_velocity_window[s_window_index] = velocity;
+    s_window_index = (s_window_index + 1) % WINDOW_SAMPLES;
+
+    if (delta != 0) s_step_total += delta * compute_step_gain(velocity, acceleration);
+
+    s_count = count;
+    s_velocity = velocity;
+    s_acceleration = acceleration;
+    return true;
+}
+
+void encoder_init(uint pio_pin)
+{
+    uint max_step_rate = 0;
+    gpio_init(pio_pin);
+    gpio_set_dir(pio_pin, GPIO_IN);
+    gpio_init(pio_pin + 1);
+    gpio_set_dir(pio_pin + 1, GPIO_IN);
+
+    PIO pio = pio0;
+    uint offset = pio_add_program(pio, &quadrature_encoder_program); 
+    uint sm = pio_claim_unused_sm(pio, true);
+    quadrature_encoder_program_init(pio,sm, offset, pio_pin, max_step_rate);
+
+    s_encoder_count_mode = COUNT_MODE_1X;
+    s_encoder_pio = pio;
+    s_encoder_sm = sm;
+
+    // window starts at the current count, so there is no spin at start
+    s_count = quadrature_encoder_get_count(pio, sm) >> s_encoder_count_mode;
+    for (int i = 0; i < WINDOW_SAMPLES; i++) s_count_window[i] = s_count;
+
+    // negative period keeps the sampling rate fixed
+    add_repeating_timer_us(-SAMPLE_PERIOD_US, sample_encoder, NULL, &s_timer);
+}
+
+int encoder_get_count()
+{
+    return s_count;
+}
+
+float encoder_get_velocity()
+{
+    return s_velocity;
+}
+
+float encoder_get_acceleration()
+{
+    return s_acceleration;
+}
+
+int encoder_take_steps()
+{
+    int32_t total = s_step_total;
+    int steps = (int)(total - s_steps_taken);
+    s_steps_taken = total;
+    return steps;
+}
@@ -0,0 +1,27 @@
+#ifndef _ENCODER_SERVICE_H_
+#define _ENCODER_SERVICE_H_
+
+#include <pico/stdlib.h>
+
+/// @brief Starts sampling the encoder at a fixed rate on the calling core.
+/// @param pio_pin The GPIO of the first encoder output, the second one
+/// is on the next GPIO.
+void encoder_init(uint pio_pin);
+
+/// @brief Returns the encoder value of the last sample, positive or negative.
+/// @return The current encoder value.
+int encoder_get_count();
+
+/// @brief Returns the encoder velocity in counts per second.
+float encoder_get_velocity();
+
+/// @brief Returns the encoder acceleration in counts per second squared.
+float encoder_get_acceleration();
+
+/// @brief Takes the steps made since the last call, counts of a fast spin
+/// are multiplied so it moves a value in big steps. Called by one reader only.
+/// @return The steps, positive or negative.
+int encoder_take_steps();
+
+// _ENCODER_SERVICE_H_
+#endif
@@ -0,0 +1,153 @@
+
+//
+// Interrupt driven keys. GPIO edges start the per-key debounce, a hardware
+// alarm ticks each millisecond only while some key is debouncing or being
+// held with autorepeat, and the resulting events go to a lock-free queue
+// with a single producer (the IRQ handlers) and a single consumer (the
+// main loop). When all keys are idle nothing runs at all, so the main loop
+// can sleep in __wfe() until an event arrives. The key state machine and
+// the queue are in input_keys.c, this file hooks them to the hardware.
+// SL (2025)
+//
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
+#include "input.h"
+#include "input_keys.h"
+
+#define TICK_MS 1
+
+static input_key_t s_keys[INPUT_MAX_KEYS];
+static uint s_num_keys = 0;
+static input_queue_t s_queue;
+
+static int s_alarm_num = -1;
+static uint32_t s_gpio_mask = 0;
+static volatile bool s_ticking = false;
+
+static inline uint32_t now_ms()
+{
+    return to_ms_since_boot(get_absolute_time());
+}
+
+static void schedule_tick()
+{
+    // when the target is already missed tick right away
+    absolute_time_t target = make_timeout_time_ms(TICK_MS);
+    if (hardware_alarm_set_target(s_alarm_num, target)) {
+        hardware_alarm_force_irq(s_alarm_num);
+    }
+}
+
+static void on_tick_alarm(uint alarm_num)
+{
+    uint32_t now = now_ms();
+    uint32_t head = s_queue.head;
+    bool need_ticks = false;
+    for (uint i = 0; i < s_num_keys; i++) {
+        input_key_t *key_ptr = &s_keys[i];
+        if (key_ptr->state == INPUT_KEY_IDLE) continue;
+        if (input_key_on_tick(key_ptr, &s_queue, gpio_get(key_ptr->gpio), now)) need_ticks = true;
+    }
+
+    // wake up the consumer sleeping in __wfe()
+    if (s_queue.head != head) __sev();
+
+    s_ticking = need_ticks;
+    if (need_ticks) schedule_tick();
+}
+
+static void on_gpio_irq()
+{
+    uint32_t now = now_ms();
+    for (uint i = 0; i < s_num_keys; i++) {
+        input_key_t *key_ptr = &s_keys[i];
+        uint32_t events = gpio_get_irq_event_mask(key_ptr->gpio) & 
+            (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL);
+        if (events == 0) continue;
+        gpio_acknowledge_irq(key_ptr->gpio, events);
+        input_key_on_edge(key_ptr, now);
+    }
+
+    // both GPIO and alarm IRQ run on this core, they can't preempt each other
+    if (!s_ticking) {
+        s_ticking = true;
+        schedule_tick();
+    }
+}
+
+/// @brief Claims the alarm and enables the GPIO interrupt, must be called on 
+/// the core which is going to consume the events.
+void input_init()
+{
+    if (s_alarm_num >= 0) return;
+
+    s_alarm_num = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(s_alarm_num, on_tick_alarm);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+// The raw handler takes only the key pins, the SDK callback keeps the
+// events of the other pins. One handler is reinstalled with the new
+// mask, a handler per key would run out of the shared IRQ slots.
+static void hook_gpio_irq(uint gpio)
+{
+    if (s_gpio_mask != 0) gpio_remove_raw_irq_handler_masked(s_gpio_mask, on_gpio_irq);
+    s_gpio_mask |= 1u << gpio;
+    gpio_add_raw_irq_handler_masked(s_gpio_mask, on_gpio_irq);
+}
+
+/// @brief Registers a key on the GPIO.
+/// @param gpio Key input pin.
+/// @param key Key code to put into the events.
+/// @param released_value GPIO value of the released key.
+/// @param autorepeat Generate repeat events while the key is held.
+/// @return False if there is no room for more keys.
+bool input_register_key(uint gpio, uint8_t key, bool released_value, bool autorepeat)
+{
+    if (s_num_keys == INPUT_MAX_KEYS) return false;
+
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+
+    input_key_init(&s_keys[s_num_keys], gpio, key, released_value, autorepeat);
+
+    // key is visible to the IRQ handler only after it's complete
+    __dmb();
+    s_num_keys += 1;
+
+    hook_gpio_irq(gpio);
+    gpio_set_irq_enabled(gpio, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+    return true;
+}
+
+/// @brief Takes the next key event from the queue without waiting.
+/// @return False if the queue is empty.
+bool input_get_event(input_event_t *event)
+{
+    return input_queue_pop(&s_queue, event);
+}
+
+/// @brief Sleeps until a key event arrives or the deadline passes.
+/// @return False on timeout.
+bool input_wait_event_until(input_event_t *event, absolute_time_t until)
+{
+    while (!input_get_event(event)) {
+        if (best_effort_wfe_or_timeout(until)) return input_get_event(event);
+    }
+    return true;
+}
+
+/// @brief Sleeps until a key event arrives or the timeout expires.
+/// @return False on timeout.
+bool input_wait_event(input_event_t *event, uint timeout_ms)
+{
+    return input_wait_event_until(event, make_timeout_time_ms(timeout_ms));
+}
+
+/// @brief Returns how many events were dropped because the queue was full.
+uint input_get_lost_events()
+{
+    return s_queue.lost_events;
+}
@@ -0,0 +1,43 @@
+#ifndef _INPUT_H
+#define _INPUT_H
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// key must stay stable this long after the last edge
+#define INPUT_DEBOUNCE_MS 10
+
+// autorepeat delays of a key being held down
+#define INPUT_FIRST_REPEAT_MS 300
+#define INPUT_LATER_REPEAT_MS 50
+
+#define INPUT_MAX_KEYS 10
+
+typedef enum input_event_type_t {
+    INPUT_KEY_DOWN,
+    INPUT_KEY_UP,
+    INPUT_KEY_REPEAT
+} input_event_type_t;
+
+typedef struct input_event_t {
+    uint8_t key;        // key code given to input_register_key()
+    uint8_t type;       // one of input_event_type_t
+    uint32_t time_ms;   // milliseconds since boot when event was detected
+} input_event_t;
+
+void input_init();
+bool input_register_key(uint gpio, uint8_t key, bool released_value, bool autorepeat);
+bool input_get_event(input_event_t *event);
+bool input_wait_event(input_event_t *event, uint timeout_ms);
+bool input_wait_event_until(input_event_t *event, absolute_time_t until);
+uint input_get_lost_events();
+
+#ifdef __cplusplus
+}
+#endif
+
+// _INPUT_H
+#endif
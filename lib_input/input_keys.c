@@ -0,0 +1,107 @@
+//
+// Per-key debounce and autorepeat state machine and the event queue of
+// the input module. The time and the pin values come from the caller, so
+// nothing here touches the hardware and the host tests drive it with
+// synthetic key traces. The queue orders its slots with C11 fences, they
+// are the memory barriers of the core on the target.
+// SL (2025)
+//
+#include <stdatomic.h>
+#include "input_keys.h"
+
+#define QUEUE_MASK (INPUT_QUEUE_SIZE - 1)
+
+// Time comparison which survives the 32-bit millisecond wrap.
+static inline bool deadline_passed(uint32_t now, uint32_t deadline)
+{
+    return (int32_t)(now - deadline) >= 0;
+}
+
+/// @brief Puts the event into the queue, counts it as lost if the queue is full.
+void input_queue_push(input_queue_t *queue, uint8_t key, input_event_type_t type, uint32_t time_ms)
+{
+    uint32_t head = queue->head;
+    if (head - queue->tail == INPUT_QUEUE_SIZE) {
+        queue->lost_events += 1;
+        return;
+    }
+
+    input_event_t *event_ptr = &queue->events[head & QUEUE_MASK];
+    event_ptr->key = key;
+    event_ptr->type = type;
+    event_ptr->time_ms = time_ms;
+
+    // publish the slot only after it's filled
+    atomic_thread_fence(memory_order_release);
+    queue->head = head + 1;
+}
+
+/// @brief Takes the oldest event from the queue.
+/// @return False if the queue is empty.
+bool input_queue_pop(input_queue_t *queue, input_event_t *event)
+{
+    uint32_t tail = queue->tail;
+    if (tail == queue->head) return false;
+
+    atomic_thread_fence(memory_order_acquire);
+    *event = queue->events[tail & QUEUE_MASK];
+
+    // release the slot only after it's copied out
+    atomic_thread_fence(memory_order_release);
+    queue->tail = tail + 1;
+    return true;
+}
+
+void input_key_init(input_key_t *key_ptr, uint gpio, uint8_t key, bool released_value, bool autorepeat)
+{
+    key_ptr->gpio = gpio;
+    key_ptr->key = key;
+    key_ptr->state = INPUT_KEY_IDLE;
+    key_ptr->released_value = released_value;
+    key_ptr->autorepeat = autorepeat;
+    key_ptr->stable_value = released_value;
+}
+
+/// @brief An edge restarts the debounce, a bouncing key keeps restarting it.
+void input_key_on_edge(input_key_t *key_ptr, uint32_t now)
+{
+    key_ptr->state = INPUT_KEY_DEBOUNCE;
+    key_ptr->debounce_deadline_ms = now + INPUT_DEBOUNCE_MS;
+}
+
+/// @brief Advances the key state machine with the pin value sampled now.
+/// @return True while the key needs ticks.
+bool input_key_on_tick(input_key_t *key_ptr, input_queue_t *queue, bool value, uint32_t now)
+{
+    switch (key_ptr->state) {
+
+        case INPUT_KEY_DEBOUNCE:
+            if (!deadline_passed(now, key_ptr->debounce_deadline_ms)) return true;
+            if (value != key_ptr->stable_value) {
+                key_ptr->stable_value = value;
+                bool pressed = (value != key_ptr->released_value);
+                input_queue_push(queue, key_ptr->key, pressed ? INPUT_KEY_DOWN : INPUT_KEY_UP, now);
+                if (pressed) {
+                    key_ptr->state = INPUT_KEY_HELD;
+                    key_ptr->repeat_deadline_ms = now + INPUT_FIRST_REPEAT_MS;
+                    return key_ptr->autorepeat;
+                }
+            } else if (value != key_ptr->released_value) {
+                // short glitch while held, keep the autorepeat going
+                key_ptr->state = INPUT_KEY_HELD;
+                return key_ptr->autorepeat;
+            }
+            key_ptr->state = INPUT_KEY_IDLE;
+            return false;
+
+        case INPUT_KEY_HELD:
+            if (!key_ptr->autorepeat) return false;
+            if (deadline_passed(now, key_ptr->repeat_deadline_ms)) {
+                input_queue_push(queue, key_ptr->key, INPUT_KEY_REPEAT, now);
+                key_ptr->repeat_deadline_ms = now + INPUT_LATER_REPEAT_MS;
+            }
+            return true;
+    }
+
+    return false;
+}
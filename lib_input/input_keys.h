@@ -0,0 +1,49 @@
+#ifndef _INPUT_KEYS_H
+#define _INPUT_KEYS_H
+
+#include "input.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// queue size must be a power of two
+#define INPUT_QUEUE_SIZE 32
+
+#define INPUT_KEY_IDLE 0
+#define INPUT_KEY_DEBOUNCE 1
+#define INPUT_KEY_HELD 2
+
+// Event queue with a single producer and a single consumer.
+typedef struct input_queue_t {
+    input_event_t events[INPUT_QUEUE_SIZE];
+    volatile uint32_t head;     // written by producer only
+    volatile uint32_t tail;     // written by consumer only
+    volatile uint lost_events;
+} input_queue_t;
+
+// Debounce and autorepeat state of one key.
+typedef struct input_key_t {
+    uint gpio;
+    uint8_t key;
+    uint8_t state;
+    bool released_value;
+    bool autorepeat;
+    bool stable_value;
+    uint32_t debounce_deadline_ms;
+    uint32_t repeat_deadline_ms;
+} input_key_t;
+
+void input_queue_push(input_queue_t *queue, uint8_t key, input_event_type_t type, uint32_t time_ms);
+bool input_queue_pop(input_queue_t *queue, input_event_t *event);
+
+void input_key_init(input_key_t *key_ptr, uint gpio, uint8_t key, bool released_value, bool autorepeat);
+void input_key_on_edge(input_key_t *key_ptr, uint32_t now);
+bool input_key_on_tick(input_key_t *key_ptr, input_queue_t *queue, bool value, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+// _INPUT_KEYS_H
+#endif
@@ -129,6 +129,15 @@ void lcdInitKeys()
     }
 }
 
+// Returns the GPIO number the key is wired to.
+uint lcdGetKeyGpio(LcdKeyType keyType)
+{
+    for (int i = 0; i < LCD_NUM_KEYS; i++) {
+        if (keyPins[i].keyType == keyType) return keyPins[i].gpio;
+    }
+    return 0;
+}
+
 #define DEBOUNCE_DURATION_US 10000
 
 static bool debounceGpio(uint gpio)
@@ -60,5 +60,6 @@ typedef struct LcdKeyEvent {
 
 void lcdInitKeys();
 LcdKeyEvent lcdGetKeyEvent();
+uint lcdGetKeyGpio(LcdKeyType keyType);
 
 #endif
\ No newline at end of file
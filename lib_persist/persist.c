@@ -0,0 +1,175 @@
+//
+// Deferred EEPROM persistence of a settings block. Changes are only marked
+// dirty, all the marks within the idle timeout are coalesced into a single
+// save. The save runs from an alarm callback page by page, each page is
+// pushed into the I2C FIFO and the 24Cxx write cycle is waited out by
+// rescheduling the alarm, so nobody ever blocks on the EEPROM. The chip is
+// reached through the driver the project gives to persist_init(), the
+// layout of the block is up to the project.
+// All the functions are expected to be called from core0.
+// SL (2025)
+//
+#include <string.h>
+#include "pico/time.h"
+#include "persist.h"
+
+// 24Cxx doesn't acknowledge anything during it's internal write cycle
+#define EEPROM_WRITE_CYCLE_US 5000
+
+// how often we look at the bus while a page is being shifted out
+#define BUS_POLL_US 500
+
+#define STATE_IDLE 0
+#define STATE_WAITING 1
+#define STATE_SHIFTING 2
+#define STATE_WRITE_CYCLE 3
+
+static const persist_eeprom_t *s_eeprom;
+static uint16_t s_address;
+static uint8_t *s_data;
+static uint s_len;
+static uint64_t s_idle_us;
+
+// s_snapshot is the copy being written now, s_stored is what EEPROM holds
+static uint8_t s_snapshot[PERSIST_MAX_BYTES];
+static uint8_t s_stored[PERSIST_MAX_BYTES];
+
+#define PAGE_STARTED 0
+#define PAGE_NONE 1     // all pages are written
+#define PAGE_FAILED 2   // the bus didn't take the page
+
+static volatile uint8_t s_state = STATE_IDLE;
+static volatile bool s_dirty = false;
+static volatile bool s_force = false;
+static volatile uint64_t s_last_change_us;
+static alarm_id_t s_alarm;
+static uint s_offset;
+static uint s_page_len;
+
+static inline uint page_length_at(uint offset)
+{
+    uint address = s_address + offset;
+    uint len = s_eeprom->page_size - (address % s_eeprom->page_size);
+    uint left = s_len - offset;
+    return (len < left) ? len : left;
+}
+
+// Starts writing the next page which differs from the stored copy,
+// returns one of PAGE_STARTED, PAGE_NONE and PAGE_FAILED.
+static uint8_t start_next_page()
+{
+    while (s_offset < s_len) {
+        uint len = page_length_at(s_offset);
+        if (memcmp(&s_snapshot[s_offset], &s_stored[s_offset], len) != 0) {
+            if (!s_eeprom->write_page_async(
+                s_address + s_offset, &s_snapshot[s_offset], len)) return PAGE_FAILED;
+            s_page_len = len;
+            return PAGE_STARTED;
+        }
+        s_offset += len;
+    }
+    return PAGE_NONE;
+}
+
+static int64_t on_persist_alarm(alarm_id_t id, void *user_data)
+{
+    switch (s_state) {
+
+        case STATE_WAITING: {
+            // keep coalescing while the changes still come
+            uint64_t idle_us = time_us_64() - s_last_change_us;
+            if (!s_force && idle_us < s_idle_us) return s_idle_us - idle_us;
+            memcpy(s_snapshot, s_data, s_len);
+            s_dirty = false;
+            s_force = false;
+            s_offset = 0;
+            break;
+        }
+
+        case STATE_SHIFTING:
+            if (s_eeprom->is_busy()) return BUS_POLL_US;
+            if (s_eeprom->take_error()) {
+                // chip didn't answer, give up until the next change
+                s_state = STATE_IDLE;
+                return 0;
+            }
+            memcpy(&s_stored[s_offset], &s_snapshot[s_offset], s_page_len);
+            s_offset += s_page_len;
+            s_state = STATE_WRITE_CYCLE;
+            return EEPROM_WRITE_CYCLE_US;
+
+        case STATE_WRITE_CYCLE:
+            break;
+    }
+
+    uint8_t result = start_next_page();
+    if (result == PAGE_STARTED) {
+        s_state = STATE_SHIFTING;
+        return BUS_POLL_US;
+    }
+
+    // the snapshot is taken again, the pages already stored are skipped
+    if (result == PAGE_FAILED) {
+        s_dirty = true;
+        s_force = true;
+        s_state = STATE_WAITING;
+        return BUS_POLL_US;
+    }
+
+    // everything is written, new changes could arrive meanwhile
+    if (s_dirty) {
+        s_state = STATE_WAITING;
+        return s_force ? BUS_POLL_US : s_idle_us;
+    }
+
+    s_state = STATE_IDLE;
+    return 0;
+}
+
+/// @brief Binds the settings block to the EEPROM address.
+/// @param eeprom Driver of the chip, must stay in memory.
+/// @param address EEPROM address the block is stored at.
+/// @param data The settings block in RAM.
+/// @param len Size of the block, up to PERSIST_MAX_BYTES.
+/// @param idle_ms How long the block must stay unchanged before it's saved.
+void persist_init(const persist_eeprom_t *eeprom, uint16_t address, void *data, uint len, uint idle_ms)
+{
+    if (len > PERSIST_MAX_BYTES) len = PERSIST_MAX_BYTES;
+
+    s_eeprom = eeprom;
+    s_address = address;
+    s_data = (uint8_t *)data;
+    s_len = len;
+    s_idle_us = (uint64_t)idle_ms * 1000;
+
+    // remember what the chip holds to skip writing unchanged pages
+    int ret = eeprom->read_bytes(address, s_stored, len);
+    if (ret != len) memset(s_stored, 0xFF, len);
+}
+
+/// @brief Tells the settings block has changed, the save is deferred.
+void persist_mark_dirty()
+{
+    s_last_change_us = time_us_64();
+    s_dirty = true;
+    if (s_state == STATE_IDLE) {
+        s_state = STATE_WAITING;
+        s_alarm = add_alarm_in_us(s_idle_us, on_persist_alarm, NULL, true);
+    }
+}
+
+/// @brief Starts saving the pending changes now without waiting for the idle timeout.
+void persist_flush()
+{
+    if (!s_dirty) return;
+    s_force = true;
+    if (s_state == STATE_WAITING && cancel_alarm(s_alarm)) {
+        s_alarm = add_alarm_in_us(BUS_POLL_US, on_persist_alarm, NULL, true);
+    }
+}
+
+/// @brief Returns true while there are changes not yet written to EEPROM.
+bool persist_is_pending()
+{
+    return s_dirty || s_state != STATE_IDLE;
+}
@@ -0,0 +1,32 @@
+#ifndef _PERSIST_H
+#define _PERSIST_H
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// blocks larger than this are cut to it
+#define PERSIST_MAX_BYTES 64
+
+// EEPROM driver of the project, the page writes must not block
+typedef struct persist_eeprom_t {
+    uint page_size;
+    int (*read_bytes)(uint16_t address, uint8_t *target, uint len);
+    bool (*write_page_async)(uint16_t address, const uint8_t *source, uint len);
+    bool (*is_busy)();
+    bool (*take_error)();
+} persist_eeprom_t;
+
+void persist_init(const persist_eeprom_t *eeprom, uint16_t address, void *data, uint len, uint idle_ms);
+void persist_mark_dirty();
+void persist_flush();
+bool persist_is_pending();
+
+#ifdef __cplusplus
+}
+#endif
+
+// _PERSIST_H
+#endif
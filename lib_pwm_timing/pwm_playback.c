@@ -0,0 +1,110 @@
+//
+// Duty table playback into a running PWM slice. A data DMA channel paced
+// by the wrap DREQ writes one table entry to the CC register per period,
+// the entry is latched by the next wrap, so the duty changes every period
+// at the switching rate. In loop mode a second channel writes the table
+// start back to the data channel, which restarts it:
+//
+//   data  - table entries to CC, one per wrap, chains to loop
+//   loop  - table start to the data channel read address trigger
+//
+// Without loop the last entry stays in CC, which suits a soft-start ramp.
+// SL (2025)
+//
+#include <math.h>
+#include "hardware/dma.h"
+#include "hardware/pwm.h"
+#include "pwm_playback.h"
+
+/// @brief Claims two DMA channels for the playback.
+void pwm_playback_init(pwm_playback_t *playback, uint slice_num)
+{
+    playback->slice_num = slice_num;
+    playback->data_channel = dma_claim_unused_channel(true);
+    playback->loop_channel = dma_claim_unused_channel(true);
+    playback->table_start = NULL;
+    playback->table_length = 0;
+}
+
+/// @brief Stops the playback and releases the DMA channels.
+void pwm_playback_deinit(pwm_playback_t *playback)
+{
+    pwm_playback_stop(playback);
+    dma_channel_unclaim(playback->data_channel);
+    dma_channel_unclaim(playback->loop_channel);
+}
+
+/// @brief Starts writing the table to the slice, one entry per period.
+/// @param playback Player of a running slice.
+/// @param table Entries made by pwm_playback_entry(), must stay in memory.
+/// @param length Number of entries.
+/// @param loop Play the table over and over until stopped.
+void pwm_playback_start(pwm_playback_t *playback, const uint32_t *table, uint length, bool loop)
+{
+    pwm_playback_stop(playback);
+    playback->table_start = table;
+    playback->table_length = length;
+
+    // chain to itself means no chaining
+    uint chain_to = loop ? playback->loop_channel : playback->data_channel;
+
+    dma_channel_config cfg = dma_channel_get_default_config(playback->data_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, true);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_dreq(&cfg, pwm_get_dreq(playback->slice_num));
+    channel_config_set_chain_to(&cfg, chain_to);
+    dma_channel_configure(playback->data_channel, &cfg, &pwm_hw->slice[playback->slice_num].cc,
+        table, length, false);
+
+    cfg = dma_channel_get_default_config(playback->loop_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, false);
+    dma_channel_configure(playback->loop_channel, &cfg,
+        &dma_hw->ch[playback->data_channel].al3_read_addr_trig, &playback->table_start, 1, false);
+
+    dma_channel_start(playback->data_channel);
+}
+
+/// @brief Returns true while the table is played, always true in loop mode.
+bool pwm_playback_is_busy(pwm_playback_t *playback)
+{
+    return dma_channel_is_busy(playback->data_channel) ||
+        dma_channel_is_busy(playback->loop_channel);
+}
+
+/// @brief Stops the playback, the slice keeps the last written levels.
+void pwm_playback_stop(pwm_playback_t *playback)
+{
+    // break the chain first, so the loop channel can't restart data
+    dma_channel_config cfg = dma_get_channel_config(playback->data_channel);
+    channel_config_set_chain_to(&cfg, playback->data_channel);
+    dma_channel_set_config(playback->data_channel, &cfg, false);
+    dma_channel_abort(playback->loop_channel);
+    dma_channel_abort(playback->data_channel);
+}
+
+/// @brief Fills the table with a linear duty ramp, same level on both channels.
+void pwm_playback_fill_ramp(uint32_t *table, uint length, const pwm_timing_t *timing,
+    float from_duty, float to_duty)
+{
+    for (uint i = 0; i < length; i++) {
+        float duty = (length > 1) ? 
+            from_duty + (to_duty - from_duty) * i / (length - 1) : to_duty;
+        uint16_t level = pwm_timing_level(timing, duty);
+        table[i] = pwm_playback_entry(level, level);
+    }
+}
+
+/// @brief Fills the table with one sine period around 50% duty, same level on both channels.
+/// @param amplitude Duty swing from the middle, 0..0.5.
+void pwm_playback_fill_sine(uint32_t *table, uint length, const pwm_timing_t *timing,
+    float amplitude)
+{
+    for (uint i = 0; i < length; i++) {
+        float duty = 0.5f + amplitude * sinf(2 * (float)M_PI * i / length);
+        uint16_t level = pwm_timing_level(timing, duty);
+        table[i] = pwm_playback_entry(level, level);
+    }
+}
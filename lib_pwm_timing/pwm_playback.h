@@ -0,0 +1,43 @@
+#ifndef _PWM_PLAYBACK_H
+#define _PWM_PLAYBACK_H
+
+#include "pico/stdlib.h"
+#include "pwm_timing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Duty table player of one slice, one table entry is written to the CC
+// register per PWM period by DMA, so the CPU is not involved at all.
+typedef struct pwm_playback_t {
+    uint slice_num;
+    uint data_channel;  // paced by wrap, writes table entries to CC
+    uint loop_channel;  // restarts the data channel from the table start
+    const uint32_t *table_start;
+    uint table_length;
+} pwm_playback_t;
+
+// Table entry with channel B level in upper half, channel A in lower.
+static inline uint32_t pwm_playback_entry(uint16_t level_a, uint16_t level_b)
+{
+    return ((uint32_t)level_b << 16) | level_a;
+}
+
+void pwm_playback_init(pwm_playback_t *playback, uint slice_num);
+void pwm_playback_deinit(pwm_playback_t *playback);
+void pwm_playback_start(pwm_playback_t *playback, const uint32_t *table, uint length, bool loop);
+bool pwm_playback_is_busy(pwm_playback_t *playback);
+void pwm_playback_stop(pwm_playback_t *playback);
+
+void pwm_playback_fill_ramp(uint32_t *table, uint length, const pwm_timing_t *timing,
+    float from_duty, float to_duty);
+void pwm_playback_fill_sine(uint32_t *table, uint length, const pwm_timing_t *timing,
+    float amplitude);
+
+#ifdef __cplusplus
+}
+#endif
+
+// _PWM_PLAYBACK_H
+#endif
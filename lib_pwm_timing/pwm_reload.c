@@ -0,0 +1,135 @@
+//
+// Glitch-free waveform change of a running PWM slice. CC and TOP of the
+// slice are double-buffered by hardware and latched at the counter wrap,
+// but DIV takes effect immediately, so the three registers written from
+// the CPU at a random moment can make one malformed period. Here the new
+// values are staged in RAM and three chained DMA channels write them:
+//
+//   wait  - dummy transfer paced by the wrap DREQ, we are at period start
+//   load  - unpaced CC and TOP write, latched by the next wrap
+//   div   - DIV write paced by that very wrap
+//
+// So the next period runs with all new values from its first counts on,
+// and the CPU is not involved after the start. A new update waits until
+// the previous one has landed, which takes at most two periods.
+// SL (2025)
+//
+#include "hardware/dma.h"
+#include "hardware/pwm.h"
+#include "pwm_reload.h"
+
+static uint32_t s_dummy;
+
+static void configure_channel(uint channel, uint dreq, uint chain_to,
+    bool read_increment, bool write_increment,
+    volatile void *write_addr, const void *read_addr, uint count)
+{
+    dma_channel_config cfg = dma_channel_get_default_config(channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, read_increment);
+    channel_config_set_write_increment(&cfg, write_increment);
+    channel_config_set_dreq(&cfg, dreq);
+    channel_config_set_chain_to(&cfg, chain_to);
+    dma_channel_configure(channel, &cfg, write_addr, read_addr, count, false);
+}
+
+/// @brief Claims three DMA channels for the slice updates.
+void pwm_reload_init(pwm_reload_t *reload, uint slice_num)
+{
+    reload->slice_num = slice_num;
+    reload->wait_channel = dma_claim_unused_channel(true);
+    reload->load_channel = dma_claim_unused_channel(true);
+    reload->div_channel = dma_claim_unused_channel(true);
+    reload->buffer_index = 0;
+
+    uint wrap_dreq = pwm_get_dreq(slice_num);
+    pwm_slice_hw_t *slice = &pwm_hw->slice[slice_num];
+
+    configure_channel(reload->wait_channel, wrap_dreq, reload->load_channel,
+        false, false, &s_dummy, &s_dummy, 1);
+
+    // CC and TOP registers go one after another
+    configure_channel(reload->load_channel, DREQ_FORCE, reload->div_channel,
+        true, true, &slice->cc, &reload->buffers[0].cc, 2);
+
+    // chain to itself means no chaining, the read address moves past
+    // the staged DIV once it's written, which marks the update complete
+    configure_channel(reload->div_channel, wrap_dreq, reload->div_channel,
+        true, false, &slice->div, &reload->buffers[0].div + 1, 1);
+}
+
+/// @brief Stops the updates and releases the DMA channels.
+void pwm_reload_deinit(pwm_reload_t *reload)
+{
+    pwm_reload_cancel(reload);
+    dma_channel_unclaim(reload->wait_channel);
+    dma_channel_unclaim(reload->load_channel);
+    dma_channel_unclaim(reload->div_channel);
+}
+
+/// @brief Returns true until the last update reaches the slice.
+bool pwm_reload_is_pending(pwm_reload_t *reload)
+{
+    // DIV is written last, then its read address is past the staged value
+    pwm_reload_values_t *values = &reload->buffers[reload->buffer_index];
+    return dma_channel_hw_addr(reload->div_channel)->read_addr != 
+        (uintptr_t)(&values->div + 1);
+}
+
+/// @brief Waits for the last update, takes at most two PWM periods.
+void pwm_reload_wait(pwm_reload_t *reload)
+{
+    while (pwm_reload_is_pending(reload)) tight_loop_contents();
+}
+
+/// @brief Drops the update in progress, call before the slice is stopped.
+void pwm_reload_cancel(pwm_reload_t *reload)
+{
+    dma_channel_abort(reload->wait_channel);
+    dma_channel_abort(reload->load_channel);
+    dma_channel_abort(reload->div_channel);
+
+    pwm_reload_values_t *values = &reload->buffers[reload->buffer_index];
+    dma_channel_set_read_addr(reload->div_channel, &values->div + 1, false);
+}
+
+/// @brief Stages new timing and levels, pwm_reload_arm_pair() starts them.
+/// @param reload Update engine of a running slice.
+/// @param timing New divider and top.
+/// @param level_a Channel A compare level.
+/// @param level_b Channel B compare level.
+void pwm_reload_stage(pwm_reload_t *reload, const pwm_timing_t *timing,
+    uint16_t level_a, uint16_t level_b)
+{
+    // the other buffer may still be read by DMA until the update completes
+    pwm_reload_wait(reload);
+    reload->buffer_index ^= 1;
+    pwm_reload_values_t *values = &reload->buffers[reload->buffer_index];
+    values->cc = ((uint32_t)level_b << PWM_CH0_CC_B_LSB) | level_a;
+    values->top = timing->top;
+    values->div = timing->div16;
+
+    dma_channel_set_read_addr(reload->load_channel, &values->cc, false);
+    dma_channel_set_write_addr(reload->load_channel, &pwm_hw->slice[reload->slice_num].cc, false);
+    dma_channel_set_read_addr(reload->div_channel, &values->div, false);
+}
+
+/// @brief Schedules new timing and levels to start with the next full period.
+/// @param reload Update engine of a running slice.
+/// @param timing New divider and top.
+/// @param level_a Channel A compare level.
+/// @param level_b Channel B compare level.
+void pwm_reload_start(pwm_reload_t *reload, const pwm_timing_t *timing,
+    uint16_t level_a, uint16_t level_b)
+{
+    pwm_reload_stage(reload, timing, level_a, level_b);
+    dma_channel_start(reload->wait_channel);
+}
+
+/// @brief Starts the staged updates of two slices at the same moment.
+/// Slices which count in sync then land on the same wrap, two separate
+/// starts could have a wrap between them and put one slice a period behind.
+void pwm_reload_arm_pair(pwm_reload_t *first, pwm_reload_t *second)
+{
+    dma_start_channel_mask((1u << first->wait_channel) | (1u << second->wait_channel));
+}
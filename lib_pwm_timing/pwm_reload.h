@@ -0,0 +1,45 @@
+#ifndef _PWM_RELOAD_H
+#define _PWM_RELOAD_H
+
+#include "pico/stdlib.h"
+#include "pwm_timing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Slice register values staged in RAM for one update.
+typedef struct pwm_reload_values_t {
+    uint32_t cc;        // channel B level in upper half, channel A in lower
+    uint32_t top;
+    uint32_t div;       // 8.4 fixed point divider
+} pwm_reload_values_t;
+
+// Update engine of one slice, new DIV/TOP/CC values are written by DMA
+// at the counter wrap so that every period is complete.
+typedef struct pwm_reload_t {
+    uint slice_num;
+    uint wait_channel;  // paced by wrap, aligns to the period start
+    uint load_channel;  // writes CC and TOP, latched by the next wrap
+    uint div_channel;   // paced by that wrap, writes DIV
+    uint buffer_index;
+    pwm_reload_values_t buffers[2];
+} pwm_reload_t;
+
+void pwm_reload_init(pwm_reload_t *reload, uint slice_num);
+void pwm_reload_deinit(pwm_reload_t *reload);
+bool pwm_reload_is_pending(pwm_reload_t *reload);
+void pwm_reload_wait(pwm_reload_t *reload);
+void pwm_reload_cancel(pwm_reload_t *reload);
+void pwm_reload_start(pwm_reload_t *reload, const pwm_timing_t *timing,
+    uint16_t level_a, uint16_t level_b);
+void pwm_reload_stage(pwm_reload_t *reload, const pwm_timing_t *timing,
+    uint16_t level_a, uint16_t level_b);
+void pwm_reload_arm_pair(pwm_reload_t *first, pwm_reload_t *second);
+
+#ifdef __cplusplus
+}
+#endif
+
+// _PWM_RELOAD_H
+#endif
@@ -0,0 +1,183 @@
+//
+// PWM top/divider solver shared by the projects. The period of a slice is
+// (top + 1) * div16 / 16 system clocks, doubled in dual-slope mode, with
+// div16 being the 8.4 fixed point divider. For the requested frequency the
+// smallest divider which lets top fit 16 bits gives the best duty
+// resolution; the search then goes through the fractional dividers up to
+// twice that value (top stays above half range). The first divider within
+// the error tolerance wins as it has the largest top, if none is that
+// close the one with the lowest frequency error is taken.
+// SL (2025)
+//
+#include "hardware/clocks.h"
+#include "pwm_timing.h"
+
+#define MIN_DIV16 16        // 1.0
+#define MAX_DIV16 4095      // 255 + 15/16
+#define MAX_COUNT 65536     // top + 1
+#define MIN_COUNT 2         // at least one level between 0 and top
+
+// frequency error small enough to stop searching
+#define TOLERANCE_PPM 10
+
+// recently solved timings, the waveform code asks for the same Hz often
+#define CACHE_SIZE 8
+
+typedef struct cache_entry_t {
+    uint hz;
+    uint32_t clock_hz;
+    pwm_timing_t timing;
+    bool ok;
+} cache_entry_t;
+
+static cache_entry_t s_cache[CACHE_SIZE];
+static uint s_cache_next = 0;
+
+static bool solve(uint32_t clock_hz, uint hz, bool dual_slope, pwm_timing_t *timing)
+{
+    bool ok = true;
+    uint slopes = dual_slope ? 2 : 1;
+    if (hz == 0) {
+        hz = 1;
+        ok = false;
+    }
+
+    // all values are scaled to be integers: div16 * count * rate = target
+    uint64_t target = (uint64_t)clock_hz * 16;
+    uint64_t rate = (uint64_t)hz * slopes;
+
+    uint64_t div_min = (target + rate * MAX_COUNT - 1) / (rate * MAX_COUNT);
+    if (div_min < MIN_DIV16) div_min = MIN_DIV16;
+    if (div_min > MAX_DIV16) {
+        // too low frequency, give the slowest timing
+        div_min = MAX_DIV16;
+        ok = false;
+    }
+
+    uint64_t div_max = 2 * div_min;
+    if (div_max > MAX_DIV16) div_max = MAX_DIV16;
+
+    uint64_t best_err = UINT64_MAX;
+    uint best_div = div_min;
+    uint best_count = MAX_COUNT;
+
+    for (uint64_t div = div_min; div <= div_max; div++) {
+        uint64_t step = div * rate;
+        uint64_t count = (target + step / 2) / step;
+        if (count > MAX_COUNT) count = MAX_COUNT;
+        if (count < MIN_COUNT) {
+            // too high frequency, give the fastest timing
+            count = MIN_COUNT;
+            ok = false;
+        }
+
+        uint64_t produced = count * step;
+        uint64_t err = (produced > target) ? (produced - target) : (target - produced);
+        if (err < best_err) {
+            best_err = err;
+            best_div = (uint)div;
+            best_count = (uint)count;
+        }
+
+        if (err * 1000000 <= target * TOLERANCE_PPM) break;
+    }
+
+    timing->top = (uint16_t)(best_count - 1);
+    timing->div16 = (uint16_t)best_div;
+    timing->dual_slope = dual_slope;
+    timing->hz = (float)clock_hz * 16 / ((float)best_div * best_count * slopes);
+    return ok;
+}
+
+/// @brief Finds the top and divider giving the frequency with the lowest error.
+/// @param hz Requested PWM frequency.
+/// @param dual_slope Phase correct mode, the counter goes up and down.
+/// @param timing Receives the timing, its hz field tells the produced frequency.
+/// @return False if the frequency is out of range and the timing is clamped.
+bool pwm_timing_solve(uint hz, bool dual_slope, pwm_timing_t *timing)
+{
+    uint32_t clock_hz = clock_get_hz(clk_sys);
+
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        cache_entry_t *entry = &s_cache[i];
+        if (entry->hz == hz && entry->clock_hz == clock_hz &&
+            entry->timing.dual_slope == dual_slope) {
+            *timing = entry->timing;
+            return entry->ok;
+        }
+    }
+
+    bool ok = solve(clock_hz, hz, dual_slope, timing);
+
+    cache_entry_t *entry = &s_cache[s_cache_next];
+    s_cache_next = (s_cache_next + 1) % CACHE_SIZE;
+    entry->hz = hz;
+    entry->clock_hz = clock_hz;
+    entry->timing = *timing;
+    entry->ok = ok;
+    return ok;
+}
+
+/// @brief Finds the top giving the frequency with the divider kept as it is.
+/// Slices which must keep their count offset, like the phase shifted legs
+/// of a bridge, change the top only.
+/// @param hz Requested PWM frequency.
+/// @param dual_slope Phase correct mode, the counter goes up and down.
+/// @param div16 The divider in 1/16 steps.
+/// @param timing Receives the timing, its hz field tells the produced frequency.
+/// @return False if top doesn't fit 16 bits with the divider, the timing is clamped.
+bool pwm_timing_solve_with_divider(uint hz, bool dual_slope, uint16_t div16, pwm_timing_t *timing)
+{
+    uint32_t clock_hz = clock_get_hz(clk_sys);
+    uint slopes = dual_slope ? 2 : 1;
+    bool ok = hz > 0;
+    if (hz == 0) hz = 1;
+
+    uint64_t target = (uint64_t)clock_hz * 16;
+    uint64_t step = (uint64_t)div16 * hz * slopes;
+    uint64_t count = (target + step / 2) / step;
+    if (count < MIN_COUNT || count > MAX_COUNT) ok = false;
+    if (count < MIN_COUNT) count = MIN_COUNT;
+    if (count > MAX_COUNT) count = MAX_COUNT;
+
+    timing->top = (uint16_t)(count - 1);
+    timing->div16 = div16;
+    timing->dual_slope = dual_slope;
+    timing->hz = (float)clock_hz * 16 / ((float)div16 * count * slopes);
+    return ok;
+}
+
+/// @brief Puts the timing into the slice configuration.
+void pwm_timing_apply(pwm_config *config, const pwm_timing_t *timing)
+{
+    pwm_config_set_phase_correct(config, timing->dual_slope);
+    pwm_config_set_wrap(config, timing->top);
+    pwm_config_set_clkdiv_int_frac(config,
+        pwm_timing_div_int(timing), pwm_timing_div_frac(timing));
+}
+
+/// @brief Changes the divider of a running slice.
+void pwm_timing_set_divider(uint slice_num, const pwm_timing_t *timing)
+{
+    pwm_set_clkdiv_int_frac(slice_num,
+        pwm_timing_div_int(timing), pwm_timing_div_frac(timing));
+}
+
+/// @brief Returns the compare level for the duty cycle given in 0..1 range.
+uint16_t pwm_timing_level(const pwm_timing_t *timing, float duty)
+{
+    if (duty <= 0) return 0;
+    uint count = timing->top + 1;
+    uint level = (uint)(duty * count + 0.5f);
+    if (level > count) level = count;
+
+    // level above top keeps the output high, 0xffff is the most 16 bits hold
+    return (level > 0xffff) ? 0xffff : (uint16_t)level;
+}
+
+/// @brief Returns the duty cycle in 0..1 range produced by the compare level.
+float pwm_timing_duty(const pwm_timing_t *timing, uint16_t level)
+{
+    float duty = (float)level / (timing->top + 1);
+    return (duty > 1) ? 1 : duty;
+}
@@ -0,0 +1,42 @@
+#ifndef _PWM_TIMING_H
+#define _PWM_TIMING_H
+
+#include "pico/stdlib.h"
+#include "hardware/pwm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PWM slice timing: the counter runs from 0 to top at the system clock
+// divided by div16/16, in dual-slope mode it runs back down to 0 too.
+typedef struct pwm_timing_t {
+    uint16_t top;       // wrap value
+    uint16_t div16;     // clock divider in 1/16 steps, 16..4095
+    bool dual_slope;    // phase correct mode
+    float hz;           // frequency actually produced
+} pwm_timing_t;
+
+bool pwm_timing_solve(uint hz, bool dual_slope, pwm_timing_t *timing);
+bool pwm_timing_solve_with_divider(uint hz, bool dual_slope, uint16_t div16, pwm_timing_t *timing);
+void pwm_timing_apply(pwm_config *config, const pwm_timing_t *timing);
+void pwm_timing_set_divider(uint slice_num, const pwm_timing_t *timing);
+uint16_t pwm_timing_level(const pwm_timing_t *timing, float duty);
+float pwm_timing_duty(const pwm_timing_t *timing, uint16_t level);
+
+static inline uint8_t pwm_timing_div_int(const pwm_timing_t *timing)
+{
+    return (uint8_t)(timing->div16 >> 4);
+}
+
+static inline uint8_t pwm_timing_div_frac(const pwm_timing_t *timing)
+{
+    return (uint8_t)(timing->div16 & 0xf);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+// _PWM_TIMING_H
+#endif
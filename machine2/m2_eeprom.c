@@ -3,9 +3,8 @@
 #include "pico/binary_info.h"
 #include "hardware/i2c.h"
 
-// EEPROM chip 24C02 (2Kb) is on bus address 0x50 and has 8-byte pages
+// EEPROM chip 24C02 (2Kb) is on bus address 0x50
 #define EEPROM_DEVICEADDR 0x50
-#define EEPROM_BYTESPERPAGE 8
 
 // SL Pi Pico board config: I2C0, SDA=Pin20, SCL=Pin21
 #define BUS_I2C_SDA_PIN 20
@@ -105,3 +104,51 @@ int eepromWriteBytes(uint16_t address, uint8_t *source, uint len)
     return len;
 }
 
+
+// Starts writing bytes which all belong to one EEPROM page and returns 
+// without waiting. Address and data are pushed straight into the I2C TX
+// FIFO (16 entries), so the controller shifts them out on its own. Returns
+// false if the bus is still busy or the page doesn't fit into the FIFO.
+// Caller must give the chip its write cycle time before the next write.
+bool eepromWritePageAsync(uint16_t address, const uint8_t *source, uint len)
+{
+    uint8_t memaddr_buf[4];
+    size_t memaddr_len = fill_memaddr_buf(memaddr_buf, address, EEPROM_BYTESPERPAGE);
+    if (len == 0 || len > EEPROM_BYTESPERPAGE) return false;
+    if (memaddr_len + len > i2c_get_write_available(i2c_default)) return false;
+    if (eepromIsBusy()) return false;
+
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+    hw->enable = 0;
+    hw->tar = EEPROM_DEVICEADDR;
+    hw->enable = 1;
+
+    // forget about the previous transfer abort if any
+    (void)hw->clr_tx_abrt;
+
+    for (size_t i = 0; i < memaddr_len; i++) hw->data_cmd = memaddr_buf[i];
+    for (uint i = 0; i < len; i++) {
+        bool last = (i == len - 1);
+        hw->data_cmd = source[i] | (last ? I2C_IC_DATA_CMD_STOP_BITS : 0);
+    }
+
+    return true;
+}
+
+// Returns true while the last async write is still on the bus.
+bool eepromIsBusy()
+{
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+    if (!(hw->status & I2C_IC_STATUS_TFE_BITS)) return true;
+    return (hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS) != 0;
+}
+
+// Returns true if the last async write was aborted (chip didn't ACK), 
+// the error is cleared by the call.
+bool eepromTakeError()
+{
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+    if (!(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS)) return false;
+    (void)hw->clr_tx_abrt;
+    return true;
+}
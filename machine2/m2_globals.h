@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 #include <pico/stdlib.h>
+#include "pwm_timing.h"
 
 // Display painting functions.
 void drawLogo();
@@ -17,8 +18,6 @@ void drawGraphGrid();
 // PWM functions.
 #define MACH_PWM_GPIO_A 0
 #define MACH_PWM_GPIO_B 1
-typedef struct PwmTopDivider { uint16_t top; uint16_t divider; } PwmTopDivider;
-PwmTopDivider pwmChooseTopDivider(uint periodsPerSecond, bool dualSlope);
 void machPwmInit();
 bool machPwmStart(uint hz, float duty, void (*wrapHandler)());
 bool machPwmChangeWaveform(uint hz, float duty);
@@ -35,10 +34,15 @@ void machAdcInit();
 uint machAdcMeasurePeriod(AdcChannel adcChannel, uint8_t *buffer, uint bufferSize);
 void machAdcHandlePeriodEnd(); 
 
+// EEPROM functions, the 24C02 chip has 8-byte pages.
+#define EEPROM_BYTESPERPAGE 8
 void eepromInit();
 void eepromScanBus();
 int eepromReadBytes(uint16_t address, uint8_t *target, uint len);
 int eepromWriteBytes(uint16_t address, uint8_t *source, uint len);
+bool eepromWritePageAsync(uint16_t address, const uint8_t *source, uint len);
+bool eepromIsBusy();
+bool eepromTakeError();
 
 // Board LED functions. 
 void ledSet(bool on);
@@ -1,12 +1,17 @@
 
 #include "m2_globals.h"
 #include "lcd114.h"
+#include "input.h"
+#include "persist.h"
 
 #define CONFIG_MAGIC 0xcafe
 #define CONFIG_EEPROM_ADDRESS 0x00
 typedef struct ConfigType { uint16_t magic; uint16_t pwmHz; float pwmDuty; } ConfigType;
 #define CONFIG_SIZE sizeof(ConfigType)
 
+// config is written only after it stays unchanged this long
+#define CONFIG_SAVE_IDLE_MS 2000
+
 typedef enum ScaleType { 
     SCALE_NONE, 
     SCALE_ACS712_5A, 
@@ -19,11 +24,20 @@ typedef enum ScaleType {
 static ConfigType _defaultConfig = { .magic = CONFIG_MAGIC, .pwmHz = 3020, .pwmDuty = 2.5 };
 static ConfigType _config;
 
+static const persist_eeprom_t _configEeprom = {
+    .page_size = EEPROM_BYTESPERPAGE,
+    .read_bytes = eepromReadBytes,
+    .write_page_async = eepromWritePageAsync,
+    .is_busy = eepromIsBusy,
+    .take_error = eepromTakeError
+};
+
 static bool _isRunning = false;
 static int _nFrames = 0;
 
 static void saveConfig();
 static void restoreConfig();
+static void initKeys();
 static void showSystemBootDisplay();
 static void refreshStartStopButton();
 static void setRunningState(bool on);
@@ -40,7 +54,7 @@ int main()
 {
     stdio_init_all();
     lcdInit();
-    lcdInitKeys();
+    initKeys();
     machPwmInit();
     machAdcInit();
     showSystemBootDisplay();
@@ -125,13 +139,14 @@ static void setRunningState(bool on)
     } else {
         //machSenseEnable(false);
         machPwmStop();
+        persist_flush();
     }
 }
 
 #define DATALEN 512
 static uint8_t data[DATALEN];
 extern uint _selectedCompareValue;
-extern PwmTopDivider _selectedTopDivider;
+extern pwm_timing_t _selectedTiming;
 
 static void refreshDisplayContent()
 {
@@ -215,25 +230,40 @@ static void scaleCapturedSamples(
     }     
 }
 
+static void initKeys()
+{
+    // pull-ups are configured by the LCD library
+    lcdInitKeys();
+    input_init();
+
+    for (int i = 0; i < LCD_NUM_KEYS; i++) {
+        LcdKeyType keyType = (LcdKeyType)i;
+        bool autorepeat = (keyType == LCD_KEY_UP || keyType == LCD_KEY_DOWN ||
+            keyType == LCD_KEY_LEFT || keyType == LCD_KEY_RIGHT);
+        input_register_key(lcdGetKeyGpio(keyType), keyType, true, autorepeat);
+    }
+}
+
+// Sleeps until a key event or timeout, keys are debounced in background.
 static LcdKeyEvent waitKeyEvent(int timeoutMillis)
 {
     LcdKeyEvent event;
     event.ready = false;
-    uint64_t startTime = time_us_64();
-    for (;;) {
-        uint64_t elapsedMillis = (time_us_64() - startTime) / 1000;
-        if (elapsedMillis > timeoutMillis) break;
-        event = lcdGetKeyEvent();
-        if (event.ready) break; 
+
+    input_event_t inputEvent;
+    if (input_wait_event(&inputEvent, timeoutMillis)) {
+        event.ready = true;
+        event.keyType = (LcdKeyType)inputEvent.key;
+        event.keyDown = (inputEvent.type != INPUT_KEY_UP);
     }
 
     return event;
 }
 
+// Marks the config changed, EEPROM write happens later in background.
 static void saveConfig()
 {
-    int ret = eepromWriteBytes(CONFIG_EEPROM_ADDRESS, (uint8_t *)&_config, CONFIG_SIZE);
-    expect(CONFIG_SIZE, ret);
+    persist_mark_dirty();
 }
 
 static void restoreConfig()
@@ -242,4 +272,6 @@ static void restoreConfig()
     if (ret != CONFIG_SIZE || _config.magic != CONFIG_MAGIC) {
         _config = _defaultConfig;
     }
+
+    persist_init(&_configEeprom, CONFIG_EEPROM_ADDRESS, &_config, CONFIG_SIZE, CONFIG_SAVE_IDLE_MS);
 }
@@ -2,15 +2,16 @@
 #include "m2_globals.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
+#include "pwm_reload.h"
 
 const bool dualSlope = false;
 static bool _isRunning = false;
 static uint _sliceNum;
 static void (*_userWrapHandler)();
 
-PwmTopDivider _selectedTopDivider;
+pwm_timing_t _selectedTiming;
 uint _selectedCompareValue;
-static volatile bool _reloadingLevel = false;
+static pwm_reload_t _reload;
 
 static void bringGpioLow(int gpio);
 static void bringOutputsLow();
@@ -22,12 +23,15 @@ void machPwmInit()
 
     // figure out which PWM slice the gpio is connected to
     _sliceNum = pwm_gpio_to_slice_num(MACH_PWM_GPIO_A);    
+
+    // waveform changes are written by DMA at the period boundary
+    pwm_reload_init(&_reload, _sliceNum);
 }
 
-static uint computeCompareValue(uint top, float duty)
+static uint computeCompareValue(const pwm_timing_t *timing, float duty)
 {
     assert(duty >= 0 && duty <= 100);
-    return (uint)(top * duty / 100);
+    return pwm_timing_level(timing, duty / 100);
 }
 
 bool machPwmStart(uint hz, float duty, void (*wrapHandler)())
@@ -40,10 +44,9 @@ bool machPwmStart(uint hz, float duty, void (*wrapHandler)())
     gpio_set_function(MACH_PWM_GPIO_B, GPIO_FUNC_PWM);
 
     pwm_config config = pwm_get_default_config();
-    PwmTopDivider topDivider = pwmChooseTopDivider(hz, dualSlope); 
-    pwm_config_set_phase_correct(&config, dualSlope);
-    pwm_config_set_wrap(&config, topDivider.top);
-    pwm_config_set_clkdiv_int(&config, topDivider.divider);
+    pwm_timing_t timing;
+    pwm_timing_solve(hz, dualSlope, &timing); 
+    pwm_timing_apply(&config, &timing);
 
     // channel A is not inverted, channel B is inverted 
     pwm_config_set_output_polarity(&config, false, true);
@@ -52,10 +55,10 @@ bool machPwmStart(uint hz, float duty, void (*wrapHandler)())
     pwm_init(_sliceNum, &config, false);
 
     // set PWM compare values for both A/B channels 
-    uint highCycles = computeCompareValue(topDivider.top, duty);
+    uint highCycles = computeCompareValue(&timing, duty);
     pwm_set_both_levels(_sliceNum, highCycles, highCycles);
 
-    _selectedTopDivider = topDivider;
+    _selectedTiming = timing;
     _selectedCompareValue = highCycles; 
 
     // Mask our slice's IRQ output into the PWM block's single interrupt line,
@@ -76,7 +79,7 @@ bool machPwmStart(uint hz, float duty, void (*wrapHandler)())
 
 void machPwmResetCounter()
 {
-    if (_isRunning && !_reloadingLevel) {
+    if (_isRunning && !pwm_reload_is_pending(&_reload)) {
         pwm_set_counter(_sliceNum, 0);
     }
 }
@@ -84,6 +87,7 @@ void machPwmResetCounter()
 bool machPwmStop()
 {
     if (!_isRunning) return false;
+    pwm_reload_cancel(&_reload);
     pwm_set_enabled(_sliceNum, false);
 
     // disable the wrap interrupt handler 
@@ -102,7 +106,6 @@ static void onPwmWrapCallback()
     if(mask & (1 << _sliceNum)) {
         pwm_clear_irq(_sliceNum);
         if (_userWrapHandler != NULL) _userWrapHandler();
-        //_reloadingLevel = false;
     }
 }
 
@@ -110,54 +113,24 @@ bool machPwmChangeWaveform(uint hz, float duty)
 {
     if (!_isRunning) return false;
 
-    PwmTopDivider newTopDivider = pwmChooseTopDivider(hz, dualSlope);
-    uint newCompareValue = computeCompareValue(newTopDivider.top, duty);
+    pwm_timing_t newTiming;
+    pwm_timing_solve(hz, dualSlope, &newTiming);
+    uint newCompareValue = computeCompareValue(&newTiming, duty);
 
-    if (newTopDivider.divider != _selectedTopDivider.divider) {
-        pwm_set_clkdiv_int_frac(_sliceNum, newTopDivider.divider, 0);
-        _selectedTopDivider.divider = newTopDivider.divider;
-    }
+    bool changed = (newTiming.div16 != _selectedTiming.div16 ||
+        newTiming.top != _selectedTiming.top ||
+        newCompareValue != _selectedCompareValue);
 
-    if (newTopDivider.top != _selectedTopDivider.top) {
-        pwm_set_wrap(_sliceNum, newTopDivider.top);
-        _selectedTopDivider.top = newTopDivider.top;
-    }
-
-    if (newCompareValue != _selectedCompareValue) {
-        pwm_set_both_levels(_sliceNum, newCompareValue, newCompareValue);
+    // all three registers change together at the next wrap
+    if (changed) {
+        pwm_reload_start(&_reload, &newTiming, newCompareValue, newCompareValue);
+        _selectedTiming = newTiming;
         _selectedCompareValue = newCompareValue;
-        //_reloadingLevel = true;
-        //while(_reloadingLevel) tight_loop_contents();
     }
 
     return true;
 }
 
-PwmTopDivider pwmChooseTopDivider(uint periodsPerSecond, bool dualSlope)
-{
-    PwmTopDivider result;
-    const uint16_t maxTop = 0xFFFF;
-    const uint16_t maxDivider = 256;
-    uint32_t clocksPerSecond = clock_get_hz(clk_sys);
-
-    uint topsPerSecond = dualSlope ? (2 * periodsPerSecond) : periodsPerSecond;
-
-    uint16_t divider = 1;
-    for (; divider <= maxDivider; divider++) {
-        // minus one cycle by RP2040 datasheet
-        uint16_t top = clocksPerSecond / (divider * topsPerSecond) - 1;
-        if (top <= maxTop) {
-            result.top = top;
-            result.divider = divider;
-            return result;  
-        }     
-    }
-
-    result.top = maxTop;
-    result.divider = maxDivider; 
-    return result;
-}
-
 static void bringOutputsLow()
 {
     bringGpioLow(MACH_PWM_GPIO_A);
@@ -2,9 +2,9 @@
 #include "machine.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
+#include "pwm_timing.h"
 
-static uint configure_pwm_slice(uint gpio_high, uint gpio_low, uint16_t top, uint16_t match, uint divider);
-static uint16_t choose_pwm_top_and_divider(uint hz, bool dual_slope, uint *divider_ptr);
+static uint configure_pwm_slice(uint gpio_high, uint gpio_low, const pwm_timing_t *timing, uint16_t match);
 static void on_wrap_callback();
 
 const uint GPIO_LEFT_HIGH = 0; 
@@ -25,12 +25,13 @@ void mach_pwm_start(uint hz, float duty, void (*wrap_handler)())
     assert(duty >= 0 && duty <= 100);
     if(_slices_are_running) mach_pwm_stop();
 
-    uint divider;
-    uint16_t top = choose_pwm_top_and_divider(hz, USE_DUAL_SLOPE, &divider);
+    pwm_timing_t timing;
+    pwm_timing_solve(hz, USE_DUAL_SLOPE, &timing);
+    uint16_t top = timing.top;
     uint16_t match = (uint16_t)(top * duty / 100);  
 
-    _left_slice = configure_pwm_slice(GPIO_LEFT_HIGH, GPIO_LEFT_LOW, top, match, divider);
-    _right_slice = configure_pwm_slice(GPIO_RIGHT_HIGH, GPIO_RIGHT_LOW, top, match, divider);
+    _left_slice = configure_pwm_slice(GPIO_LEFT_HIGH, GPIO_LEFT_LOW, &timing, match);
+    _right_slice = configure_pwm_slice(GPIO_RIGHT_HIGH, GPIO_RIGHT_LOW, &timing, match);
 
     if (wrap_handler != NULL) {
         _user_wrap_handler = wrap_handler; 
@@ -78,7 +79,7 @@ static void on_wrap_callback()
 }
 
 static uint configure_pwm_slice(
-    uint gpio_high, uint gpio_low, uint16_t top, uint16_t match, uint divider)
+    uint gpio_high, uint gpio_low, const pwm_timing_t *timing, uint16_t match)
 {
     // figure out which slice we just connected to the pin
     uint slice_num = pwm_gpio_to_slice_num(gpio_high);
@@ -94,9 +95,7 @@ static uint configure_pwm_slice(
     gpio_set_function(gpio_low, GPIO_FUNC_PWM);
 
     pwm_config config = pwm_get_default_config();
-    pwm_config_set_phase_correct(&config, USE_DUAL_SLOPE);
-    pwm_config_set_wrap(&config, top);
-    pwm_config_set_clkdiv_int(&config, divider);
+    pwm_timing_apply(&config, timing);
 
     // channel A is not inverted, channel B is inverted 
     pwm_config_set_output_polarity(&config, false, true);
@@ -109,32 +108,3 @@ static uint configure_pwm_slice(
 
     return slice_num; 
 }
-
-// For the given frequency and PWM mode returns the TOP/WRAP value, 
-// if the divider_ptr is provided stores there the DIVIDER value.
-static uint16_t choose_pwm_top_and_divider(
-    uint hz, bool dual_slope, uint *divider_ptr)
-{
-    const uint max_top = 0xFFFF;
-    const int max_divider = 256;
-    uint32_t clocks_per_second = clock_get_hz(clk_sys);
-    uint periods_per_second = hz;
-
-    uint tops_per_second = dual_slope ? 
-        (2 * periods_per_second) : periods_per_second;
-
-    uint divider = 1;
-    for (; divider <= max_divider; divider++) {
-        // minus one cycle by RP2040 datasheet
-        uint top = clocks_per_second / (divider * tops_per_second) - 1;
-        if (top <= max_top) {
-            if (divider_ptr != NULL) *divider_ptr = divider;
-            return top;  
-        }     
-    }
-
-    if (divider_ptr != NULL) *divider_ptr = max_divider; 
-    return max_top;
-}
-
-
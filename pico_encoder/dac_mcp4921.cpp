@@ -47,16 +47,21 @@ static inline void cs_deselect()
     asm volatile("nop \n nop \n nop");
 }
 
-// Write the 12-bit value to the MCP.
-void mcp4921_write_dac(uint16_t data)
+// Build the 16-bit register word, 4 MSB bits are flags, 12 LSB bits are data.
+uint16_t mcp4921_make_word(uint16_t data)
 {
-    // Build the 16-bit register word, 4 MSB bits are flags, 12 LSB bits are data.
-    uint16_t reg = 
+    return 
       (0 << 15) | // channel A=0, channel B=1
       (0 << 14) | // buffered=1 (high impendance), unbuffered=0 (full range with 165kOhm impendance)
       (1 << 13) | // gain 1x=1, gain 2x=0
       (1 << 12) | // power up=1, power down=0
       data & 0x0FFF; 
+}
+
+// Write the 12-bit value to the MCP.
+void mcp4921_write_dac(uint16_t data)
+{
+      uint16_t reg = mcp4921_make_word(data);
 
       cs_select();
       spi_write16_blocking(MCP_SPI_INSTANCE, &reg, 1);
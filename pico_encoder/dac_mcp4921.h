@@ -10,4 +10,9 @@ void mcp4921_deinit();
 // Write the 12-bit value to the MCP4921 DAC.
 void mcp4921_write_dac(uint16_t data);
 
+// Build the SPI word which writes the 12-bit value to the DAC.
+uint16_t mcp4921_make_word(uint16_t data);
+
+#define MCP4921_MAX_VALUE 0x0fff
+
 #endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+//
+// DDS waveform generator on the MCP4921 DAC. A DMA timer paces the DAC
+// words to the SPI at a fixed sample rate, two DMA channels play two
+// sample buffers by turns. The buffer which was played is refilled from
+// the waveform table by a 32-bit phase accumulator, so the frequency has
+// fine steps at any sample rate and the CPU only works once per buffer.
+// The samples are interpolated between the table points, so the short
+// table keeps the 12 bits of the DAC.
+// SL (2025)
+//
+#include <math.h>
+#include <hardware/spi.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/clocks.h>
+#include "board_config.h"
+#include "dac_mcp4921.h"
+#include "dds.h"
+
+#define DDS_SPI_INSTANCE BOARD_SPI_INSTANCE
+
+// MCP4921 takes up to 20MHz, one word is then well within a sample
+#define DDS_SPI_BAUDRATE (10 * 1000 * 1000)
+
+// 2.5ms of samples at 100K samples per second
+#define BUFFER_SAMPLES 256
+
+// phase bits above the index are the point, 16 below it the fraction
+#define PHASE_INDEX_SHIFT (32 - DDS_TABLE_BITS)
+#define PHASE_FRACTION_SHIFT (PHASE_INDEX_SHIFT - 16)
+
+static uint16_t s_tables[DDS_WAVE_COUNT][DDS_TABLE_SIZE];
+static const uint16_t *volatile s_table = s_tables[DDS_WAVE_SINE];
+static uint16_t s_buffers[2][BUFFER_SAMPLES];
+
+static uint s_channels[2];
+static int s_timer;
+static uint s_sample_rate;
+static volatile uint32_t s_phase_step;
+static uint32_t s_phase;
+static float s_frequency;
+static dds_wave_t s_wave = DDS_WAVE_SINE;
+static bool s_is_running = false;
+
+static const char *s_wave_names[DDS_WAVE_COUNT] = { "sin", "tri", "saw", "usr" };
+
+static void fill_tables()
+{
+    const int half = MCP4921_MAX_VALUE / 2;
+    for (int i = 0; i < DDS_TABLE_SIZE; i++) {
+        float sine = sinf(2 * (float)M_PI * i / DDS_TABLE_SIZE);
+        int rise = i * 2 * MCP4921_MAX_VALUE / DDS_TABLE_SIZE;
+        int triangle = (i < DDS_TABLE_SIZE / 2) ? rise : 2 * MCP4921_MAX_VALUE - rise;
+        int sawtooth = i * MCP4921_MAX_VALUE / (DDS_TABLE_SIZE - 1);
+
+        s_tables[DDS_WAVE_SINE][i] = (uint16_t)(half + half * sine);
+        s_tables[DDS_WAVE_TRIANGLE][i] = (uint16_t)MIN(triangle, MCP4921_MAX_VALUE);
+        s_tables[DDS_WAVE_SAWTOOTH][i] = (uint16_t)sawtooth;
+        s_tables[DDS_WAVE_USER][i] = (uint16_t)half;
+    }
+}
+
+static void fill_buffer(uint16_t *buffer)
+{
+    const uint16_t *table = s_table;
+    const uint16_t control = mcp4921_make_word(0);
+    uint32_t step = s_phase_step;
+    uint32_t phase = s_phase;
+    for (int i = 0; i < BUFFER_SAMPLES; i++) {
+        // the last point goes on to the first one
+        uint index = phase >> PHASE_INDEX_SHIFT;
+        int32_t value = table[index];
+        int32_t next = table[(index + 1) & (DDS_TABLE_SIZE - 1)];
+        int32_t fraction = (phase >> PHASE_FRACTION_SHIFT) & 0xffff;
+        buffer[i] = control | (uint16_t)(value + (((next - value) * fraction) >> 16));
+        phase += step;
+    }
+    s_phase = phase;
+}
+
+static void on_buffer_played()
+{
+    for (int i = 0; i < 2; i++) {
+        uint channel = s_channels[i];
+        if (dma_channel_get_irq0_status(channel)) {
+            dma_channel_acknowledge_irq0(channel);
+
+            // the other channel plays now, this one is ready in time
+            fill_buffer(s_buffers[i]);
+            dma_channel_set_read_addr(channel, s_buffers[i], false);
+        }
+    }
+}
+
+void dds_init(uint sample_rate)
+{
+    fill_tables();
+    spi_set_baudrate(DDS_SPI_INSTANCE, DDS_SPI_BAUDRATE);
+
+    // timer paces the samples at clk_sys / divider
+    s_sample_rate = sample_rate;
+    s_timer = dma_claim_unused_timer(true);
+    dma_timer_set_fraction(s_timer, 1, (uint16_t)(clock_get_hz(clk_sys) / sample_rate));
+
+    s_channels[0] = dma_claim_unused_channel(true);
+    s_channels[1] = dma_claim_unused_channel(true);
+    for (int i = 0; i < 2; i++) {
+        dma_channel_config cfg = dma_channel_get_default_config(s_channels[i]);
+        channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+        channel_config_set_read_increment(&cfg, true);
+        channel_config_set_write_increment(&cfg, false);
+        channel_config_set_dreq(&cfg, dma_get_timer_dreq(s_timer));
+        channel_config_set_chain_to(&cfg, s_channels[1 - i]);
+        dma_channel_configure(s_channels[i], &cfg, &spi_get_hw(DDS_SPI_INSTANCE)->dr,
+            s_buffers[i], BUFFER_SAMPLES, false);
+        dma_channel_set_irq0_enabled(s_channels[i], true);
+    }
+
+    irq_set_exclusive_handler(DMA_IRQ_0, on_buffer_played);
+    irq_set_enabled(DMA_IRQ_0, true);
+    dds_set_frequency(1000);
+}
+
+void dds_start()
+{
+    if (s_is_running) return;
+
+    s_phase = 0;
+    for (int i = 0; i < 2; i++) {
+        fill_buffer(s_buffers[i]);
+        dma_channel_set_read_addr(s_channels[i], s_buffers[i], false);
+        dma_channel_set_trans_count(s_channels[i], BUFFER_SAMPLES, false);
+    }
+
+    s_is_running = true;
+    dma_channel_start(s_channels[0]);
+}
+
+void dds_stop()
+{
+    if (!s_is_running) return;
+
+    // break the chains before aborting, so neither restarts the other
+    for (int i = 0; i < 2; i++) {
+        dma_channel_config cfg = dma_get_channel_config(s_channels[i]);
+        channel_config_set_chain_to(&cfg, s_channels[i]);
+        dma_channel_set_config(s_channels[i], &cfg, false);
+    }
+    dma_channel_abort(s_channels[0]);
+    dma_channel_abort(s_channels[1]);
+
+    // chains are restored for the next start
+    for (int i = 0; i < 2; i++) {
+        dma_channel_config cfg = dma_get_channel_config(s_channels[i]);
+        channel_config_set_chain_to(&cfg, s_channels[1 - i]);
+        dma_channel_set_config(s_channels[i], &cfg, false);
+        dma_channel_acknowledge_irq0(s_channels[i]);
+    }
+    s_is_running = false;
+}
+
+void dds_set_frequency(float hz)
+{
+    // phase step of one sample, the full turn is 2^32
+    s_frequency = hz;
+    s_phase_step = (uint32_t)((double)hz * 4294967296.0 / s_sample_rate);
+}
+
+float dds_get_frequency()
+{
+    return s_frequency;
+}
+
+void dds_set_wave(dds_wave_t wave)
+{
+    if (wave >= DDS_WAVE_COUNT) return;
+    s_wave = wave;
+    s_table = s_tables[wave];
+}
+
+dds_wave_t dds_get_wave()
+{
+    return s_wave;
+}
+
+const char *dds_get_wave_name(dds_wave_t wave)
+{
+    return (wave < DDS_WAVE_COUNT) ? s_wave_names[wave] : "???";
+}
+
+void dds_set_user_point(int index, uint16_t value)
+{
+    if (index < 0 || index >= DDS_TABLE_SIZE) return;
+    s_tables[DDS_WAVE_USER][index] = MIN(value, MCP4921_MAX_VALUE);
+}
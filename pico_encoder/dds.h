@@ -0,0 +1,39 @@
+#ifndef _DDS_H_
+#define _DDS_H_
+
+#include <pico/stdlib.h>
+
+typedef enum
+{
+    DDS_WAVE_SINE,
+    DDS_WAVE_TRIANGLE,
+    DDS_WAVE_SAWTOOTH,
+    DDS_WAVE_USER,
+    DDS_WAVE_COUNT
+} dds_wave_t;
+
+// one period of the waveform in 12-bit DAC values, the samples are
+// interpolated between the points
+#define DDS_TABLE_BITS 8
+#define DDS_TABLE_SIZE (1 << DDS_TABLE_BITS)
+
+/// @brief Prepares the tables and DMA, the DAC driver has set up SPI.
+/// @param sample_rate DAC samples per second.
+void dds_init(uint sample_rate);
+
+/// @brief Starts playing, mcp4921_write_dac() must not be called until stopped.
+void dds_start();
+void dds_stop();
+
+void dds_set_frequency(float hz);
+float dds_get_frequency();
+
+void dds_set_wave(dds_wave_t wave);
+dds_wave_t dds_get_wave();
+const char *dds_get_wave_name(dds_wave_t wave);
+
+/// @brief Sets one 12-bit point of the user waveform table.
+void dds_set_user_point(int index, uint16_t value);
+
+// _DDS_H_
+#endif
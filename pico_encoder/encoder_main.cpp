@@ -2,8 +2,9 @@
 #include "encoder.h"
 #include <hardware/gpio.h>
 #include "dac_mcp4921.h"
-#include "quadrature.pio.h"
 #include "eeprom_24cxx.h"
+#include "encoder_service.h"
+#include "dds.h"
 
 int g_count;
 char g_buffer[100];
@@ -11,19 +12,27 @@ char g_buffer[100];
 // see button debounce library https://github.com/TuriSc/RP2040-Button
 void gpio_callback(uint gpio, uint32_t events);
 
-static void encoder_init();
-static int encoder_read();
-
 int falls = 0;
 int rises = 0;
 
+#define DDS_SAMPLE_RATE (100 * 1000)
+#define DDS_MIN_HZ 10
+#define DDS_MAX_HZ 10000
+#define DDS_HZ_PER_STEP 10
+
+#define HOST_LINE_SIZE 32
+static char _host_line[HOST_LINE_SIZE];
+static int _host_line_length = 0;
+
+static void process_host_input();
+
 int main() 
 {
     stdio_init_all();
     sleep_ms(500);
 
     eeprom_init();
-    encoder_init();
+    encoder_init(ENCODER_S1_PIN);
 
     //eeprom_scan_bus();
 
@@ -39,22 +48,24 @@ int main()
     sprintf(g_buffer, "ready");
     encoder_display_repaint();
 
+    // DAC plays the waveform from now on, encoder sets its frequency
+    dds_init(DDS_SAMPLE_RATE);
+    dds_start();
+
     const int cycle_ms = 100; 
 
-    uint16_t v = 0; 
-    uint16_t max_v = 0x0fff;
-    
     while(true) {
-        
-        mcp4921_write_dac(v); 
 
-        int n = encoder_read();
+        process_host_input();
 
-        float f_v = (v * 3.3) / max_v;
-        sprintf(g_buffer, "v=%.2f %d", f_v, n);
+        int steps = encoder_take_steps();
+        if (steps != 0) {
+            float hz = dds_get_frequency() + steps * DDS_HZ_PER_STEP;
+            dds_set_frequency(MAX(DDS_MIN_HZ, MIN(DDS_MAX_HZ, hz)));
+        }
 
-        v += max_v / (5 * 20);
-        if (v > max_v) v = 0;
+        g_count = encoder_get_count();
+        sprintf(g_buffer, "%s %.0fHz", dds_get_wave_name(dds_get_wave()), dds_get_frequency());
         
         //sprintf(g_buffer, "e%d r%d f%d", n, rises, falls); 
 
@@ -78,42 +89,28 @@ void gpio_callback(uint gpio, uint32_t events) {
     //sprintf(g_buffer, "%d r%d f%d", last, rises, falls);
 }
 
-#define COUNT_MODE_1X 2
-#define COUNT_MODE_2X 1
-#define COUNT_MODE_4X 0
-
-static PIO s_encoder_pio;
-static int s_encoder_sm;
-static int s_encoder_count_mode;
-
-static void encoder_init()
+// Host commands are lines: WAVE n selects the waveform, FREQ hz sets the
+// frequency, POINT i v sets the point i of the user waveform to 12-bit v.
+static void execute_host_line(const char *line)
 {
-    //gpio_init(ENCODER_KEY_PIN);
-    //gpio_set_dir(ENCODER_KEY_PIN, GPIO_IN);
-
-    //gpio_set_irq_enabled_with_callback(ENCODER_KEY_PIN, 
-    //    GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL,
-    //    true, &gpio_callback); 
-
-    uint pio_pin = ENCODER_S1_PIN;
-    uint max_step_rate = 0;
-    gpio_init(pio_pin);
-    gpio_set_dir(pio_pin, GPIO_IN);
-    gpio_init(pio_pin + 1);
-    gpio_set_dir(pio_pin + 1, GPIO_IN);
-
-    PIO pio = pio0;
-    uint offset = pio_add_program(pio, &quadrature_encoder_program); 
-    uint sm = pio_claim_unused_sm(pio, true);
-    quadrature_encoder_program_init(pio,sm, offset, pio_pin, max_step_rate);
-
-    s_encoder_count_mode = COUNT_MODE_1X;
-    s_encoder_pio = pio;
-    s_encoder_sm = sm;
+    int a, b;
+    if (sscanf(line, "WAVE %d", &a) == 1) dds_set_wave((dds_wave_t)a);
+    else if (sscanf(line, "FREQ %d", &a) == 1) dds_set_frequency(MAX(DDS_MIN_HZ, MIN(DDS_MAX_HZ, a)));
+    else if (sscanf(line, "POINT %d %d", &a, &b) == 2) dds_set_user_point(a, (uint16_t)b);
 }
 
-static int encoder_read()
+static void process_host_input()
 {
-    return quadrature_encoder_get_count(s_encoder_pio, s_encoder_sm) >> s_encoder_count_mode;
+    int ch;
+    while ((ch = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+        if (ch == '\r') continue;
+        if (ch == '\n') {
+            _host_line[_host_line_length] = 0;
+            execute_host_line(_host_line);
+            _host_line_length = 0;
+        }
+        else if (_host_line_length < HOST_LINE_SIZE - 1) {
+            _host_line[_host_line_length++] = (char)ch;
+        }
+    }
 }
-
@@ -4,59 +4,21 @@
 // SL (06.04.2025)
 //
 #include <pico/stdlib.h>
-#include <hardware/spi.h>
-#include <hardware/gpio.h>
 #include "board_config.h"
+#include "spi_bus.h"
 #include "adc_ad7887.h"
 
-#define ADC_SPI_INSTANCE BOARD_SPI_INSTANCE
-#define ADC_SPI_BAUDRATE BOARD_SPI_BAUDRATE
-#define ADC_SPI_SCK_PIN BOARD_SPI_SCK_PIN
-#define ADC_SPI_TX_PIN BOARD_SPI_TX_PIN
-#define ADC_SPI_RX_PIN BOARD_SPI_RX_PIN
-#define ADC_SPI_CS_PIN BOARD_SPI_CS2_PIN
+// AD7887 is on the CS2 pin of the shared bus.
+#define ADC_SPI_CHIP SPI_BUS_CS2_CHIP
 
 void ad7887_init()
 {
-    spi_init(ADC_SPI_INSTANCE, ADC_SPI_BAUDRATE);
-
-    // All writes to the AD7887 are 16-bit words. 
-    spi_set_format(ADC_SPI_INSTANCE, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
-
-    gpio_set_function(ADC_SPI_SCK_PIN, GPIO_FUNC_SPI);
-    gpio_set_function(ADC_SPI_TX_PIN, GPIO_FUNC_SPI);
-    gpio_set_function(ADC_SPI_RX_PIN, GPIO_FUNC_SPI);
-
-    gpio_init(ADC_SPI_CS_PIN);
-    gpio_set_dir(ADC_SPI_CS_PIN, GPIO_OUT);
-    gpio_put(ADC_SPI_CS_PIN, 1); 
-}
-
-void ad7887_deinit()
-{
-    spi_deinit(ADC_SPI_INSTANCE);
+    // All writes to the AD7887 are 16-bit words, the bus does them.
+    spi_bus_init();
 }
 
-// Enable chip communication.
-static inline void cs_select() 
+uint16_t ad7887_make_control_word(uint8_t channel)
 {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(ADC_SPI_CS_PIN, 0);  // Active low
-    asm volatile("nop \n nop \n nop");
-}
-
-// Disable chip communication.
-static inline void cs_deselect() 
-{
-    asm volatile("nop \n nop \n nop");
-    gpio_put(ADC_SPI_CS_PIN, 1);
-    asm volatile("nop \n nop \n nop");
-}
-
-uint16_t ad7887_read_adc(uint8_t channel)
-{
-    if (channel > 1) return AD7887_MAX_VALUE;
-
     // Build the 16-bit register word, 8 MSB bits go to control register, 8 LSB bits are ignored.
     uint8_t reg8 = 
       (0 << 7) | // Don’t Care. It doesn’t matter if the bit is 0 or 1.
@@ -68,12 +30,12 @@ uint16_t ad7887_read_adc(uint8_t channel)
       (0 << 1) | // PM1=0. Power management Mode2: PM1=0, PM0=1. In this mode, the AD7887 is always fully powered up. 
       (1 << 0);  // PM0=1.
 
-    uint16_t output16 = ((uint16_t)reg8 << 8); 
-    uint16_t input16; 
+    return ((uint16_t)reg8 << 8); 
+}
 
-    cs_select();
-    spi_write16_read16_blocking(ADC_SPI_INSTANCE, &output16, &input16, 1);
-    cs_deselect();
+uint16_t ad7887_read_adc(uint8_t channel)
+{
+    if (channel > 1) return AD7887_MAX_VALUE;
 
-    return input16;
+    return spi_bus_transfer(ADC_SPI_CHIP, ad7887_make_control_word(channel));
 }
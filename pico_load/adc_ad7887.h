@@ -5,12 +5,15 @@
 #include <pico/stdlib.h>
 
 void ad7887_init();
-void ad7887_deinit();
 
 /// @brief Reads the 12-bit value from the AD7887 ADC channel.
 /// @param data ADC channel number: 0 or 1.
 uint16_t ad7887_read_adc(uint8_t channel);
 
+/// @brief Builds the SPI word which selects the channel of the next conversion.
+/// @param channel ADC channel number: 0 or 1.
+uint16_t ad7887_make_control_word(uint8_t channel);
+
 #define AD7887_MAX_VALUE 0x0fff
 
 inline float ad7887_convert_adc_to_volts(uint16_t adc, float max_volts) {
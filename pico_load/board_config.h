@@ -28,14 +28,20 @@
 #define EEPROM_I2C_SDA_PIN BOARD_I2C_SDA_PIN
 #define EEPROM_I2C_SCL_PIN BOARD_I2C_SCL_PIN
 
-// SPI bus pins
-#define BOARD_SPI_INSTANCE spi0
-#define BOARD_SPI_BAUDRATE (1000 * 1000)
+// SPI bus pins, the bus is driven by PIO, see spi_bus.pio
+// AD7887 takes at most 2MHz clock, that is 125K conversions per second
+#define BOARD_SPI_BAUDRATE (2000 * 1000)
 #define BOARD_SPI_SCK_PIN 2
 #define BOARD_SPI_TX_PIN 3
 #define BOARD_SPI_RX_PIN 4
-#define BOARD_SPI_CS1_PIN 5 // ADC
-#define BOARD_SPI_CS2_PIN 1 // DAC
+#define BOARD_SPI_CS1_PIN 5 // DAC
+#define BOARD_SPI_CS2_PIN 1 // ADC
+
+// Load sense at the ADC reference: channel 0 reads the shunt amplifier,
+// channel 1 reads the input voltage divider
+#define LOAD_CURRENT_FULL_SCALE_MA 3300
+#define LOAD_VOLTAGE_FULL_SCALE_MV 33000
+#define LOAD_MAX_CURRENT_MA 3000
 
 #define ENCODER_KEY_PIN 22
 #define ENCODER_S1_PIN 18
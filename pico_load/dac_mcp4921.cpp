@@ -2,71 +2,51 @@
 // SPI driver for the MCP4921 12-bit Digital-to-Analog converter.
 // SL (18.02.2025)
 //
-#include "board_config.h"
-#include <hardware/spi.h>
-#include <hardware/gpio.h>
 #include <pico/stdlib.h>
+#include "board_config.h"
+#include "spi_bus.h"
+#include "dac_mcp4921.h"
 
 // LDAC pin is pulled low so conversion starts on CS up. 
-#define MCP_SPI_INSTANCE BOARD_SPI_INSTANCE
-#define MCP_SPI_BAUDRATE BOARD_SPI_BAUDRATE
-#define MCP_SPI_SCK_PIN BOARD_SPI_SCK_PIN
-#define MCP_SPI_TX_PIN BOARD_SPI_TX_PIN
-#define MCP_SPI_CS_PIN BOARD_SPI_CS1_PIN
+#define MCP_SPI_CHIP SPI_BUS_CS1_CHIP
+
+static absolute_time_t s_settle_deadline;
 
 void mcp4921_init()
 {
-    spi_init(MCP_SPI_INSTANCE, MCP_SPI_BAUDRATE);
-
-    // All writes to the MCP492X are 16-bit words. 
-    spi_set_format(MCP_SPI_INSTANCE, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
-
-    // RX pin is not used
-    gpio_set_function(MCP_SPI_SCK_PIN, GPIO_FUNC_SPI);
-    gpio_set_function(MCP_SPI_TX_PIN, GPIO_FUNC_SPI);
-    
-    gpio_init(MCP_SPI_CS_PIN);
-    gpio_set_dir(MCP_SPI_CS_PIN, GPIO_OUT);
-    gpio_put(MCP_SPI_CS_PIN, 1); 
+    // All writes to the MCP492X are 16-bit words, the bus does them.
+    spi_bus_init();
 }
 
-void mcp4921_deinit()
+// Build the 16-bit register word, 4 MSB bits are flags, 12 LSB bits are data.
+uint16_t mcp4921_make_word(uint16_t data)
 {
-    spi_deinit(MCP_SPI_INSTANCE);
+    return 
+      (0 << 15) | // channel A=0, channel B=1
+      (0 << 14) | // buffered=1 (high impendance), unbuffered=0 (full range with 165kOhm impendance)
+      (1 << 13) | // gain 1x=1, gain 2x=0
+      (1 << 12) | // power up=1, power down=0
+      data & 0x0FFF; 
 }
 
-// Enable chip communication.
-static inline void cs_select() 
+// Queue the 12-bit value to the MCP, the output settles after the word
+// is out, so the caller can do other bus work in the meantime. The FIFO
+// level counts our word and those ahead of it, one more may be on the
+// wire, so the deadline holds however much was queued before.
+void mcp4921_write_dac(uint16_t data)
 {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(MCP_SPI_CS_PIN, 0);  // Active low
-    asm volatile("nop \n nop \n nop");
+      spi_bus_write_async(MCP_SPI_CHIP, mcp4921_make_word(data));
+      uint transfers = spi_bus_get_tx_level() + 1;
+      s_settle_deadline = make_timeout_time_us(transfers * SPI_BUS_TRANSFER_US + MCP4921_SETTLE_US);
 }
 
-// Disable chip communication.
-static inline void cs_deselect() 
+void mcp4921_wait_settled()
 {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(MCP_SPI_CS_PIN, 1);
-    asm volatile("nop \n nop \n nop");
+      busy_wait_until(s_settle_deadline);
 }
 
-// Write the 12-bit value to the MCP.
-void mcp4921_write_dac(uint16_t data)
+bool mcp4921_is_settled()
 {
-    // Build the 16-bit register word, 4 MSB bits are flags, 12 LSB bits are data.
-    uint16_t reg = 
-      (0 << 15) | // channel A=0, channel B=1
-      (0 << 14) | // buffered=1 (high impendance), unbuffered=0 (full range with 165kOhm impendance)
-      (1 << 13) | // gain 1x=1, gain 2x=0
-      (1 << 12) | // power up=1, power down=0
-      data & 0x0FFF; 
-
-      cs_select();
-      spi_write16_blocking(MCP_SPI_INSTANCE, &reg, 1);
-      cs_deselect();
-
-      // settling time is 4.5uSec
-      sleep_us(10);
+      return time_reached(s_settle_deadline);
 }
 
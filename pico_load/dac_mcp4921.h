@@ -5,12 +5,24 @@
 #include <pico/stdlib.h>
 
 void mcp4921_init();
-void mcp4921_deinit();
 
-/// @brief Writes the 12-bit value to the MCP4921 DAC.
+/// @brief Queues the 12-bit value to the MCP4921 DAC and returns at once.
 /// @param data The 12-bit value to write into DAC.
 void mcp4921_write_dac(uint16_t data);
 
+/// @brief Waits until the output of the last write has settled.
+void mcp4921_wait_settled();
+
+/// @brief Returns true once the output of the last write has settled.
+bool mcp4921_is_settled();
+
+/// @brief Builds the SPI word which writes the 12-bit value to the DAC.
+/// @param data The 12-bit value to write into DAC.
+uint16_t mcp4921_make_word(uint16_t data);
+
 #define MCP4921_MAX_VALUE 0x0fff
 
+// settling time is 4.5uSec
+#define MCP4921_SETTLE_US 5
+
 #endif
\ No newline at end of file
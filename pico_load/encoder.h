@@ -1,11 +0,0 @@
-#ifndef _ENCODER_H_
-#define _ENCODER_H_
-
-void encoder_init();
-
-/// @brief Reads the current integer encoder value positive or negative.
-/// @return The current encoder value.
-int encoder_get_count();
-
-// _ENCODER_H_
-#endif
\ No newline at end of file
@@ -15,7 +15,7 @@ void board_display_repaint();
 void board_led_init();
 void board_led_set(bool on);
 
-extern int g_count;
+extern char g_title[];
 extern char g_buffer[];
 
 // _LOAD_GLOBALS_H_
@@ -0,0 +1,186 @@
+//
+// Electronic load controller in constant current, constant resistance and
+// constant power modes. A fixed rate timer on the core which started it
+// runs a fixed-point PI loop, see load_loop.cpp, from the sensed current
+// to the DAC value which drives the MOSFET gate. Resistance and power targets are turned
+// into a current setpoint from the sensed voltage, the setpoint follows
+// its demand with a limited slew rate. The sample stream also goes to
+// the oversampling stage for the readings of higher resolution and to
+// the energy integrator, which takes the target to zero at the cutoff.
+// SL (2025)
+//
+#include <pico/time.h>
+#include "board_config.h"
+#include "dac_mcp4921.h"
+#include "adc_ad7887.h"
+#include "spi_sequencer.h"
+#include "telemetry.h"
+#include "load_transient.h"
+#include "oversample.h"
+#include "load_energy.h"
+#include "load_control.h"
+#include "load_loop.h"
+
+// sequencer gives 4 or 5 sample pairs per period, about 4.7 on average
+#define MAX_PAIRS_PER_TICK 16
+
+static alarm_pool_t *s_alarm_pool;
+static repeating_timer_t s_timer;
+
+static volatile load_mode_t s_mode = LOAD_MODE_CC;
+static volatile int32_t s_target = 0;
+
+static volatile int32_t s_setpoint_ma = 0;
+static volatile int32_t s_current_ma = 0;
+static volatile int32_t s_voltage_mv = 0;
+static volatile uint16_t s_dac_value = 0;
+static volatile uint32_t s_pairs = 0;
+static load_loop_t s_loop;
+
+// the stages belong to the loop, core0 asks for a new ratio
+static oversample_t s_current_os;
+static oversample_t s_voltage_os;
+static volatile uint s_os_ratio = 1;
+static volatile uint s_os_ratio_request = 1;
+static volatile uint16_t s_current_fine = 0;
+static volatile uint16_t s_voltage_fine = 0;
+static volatile bool s_dither = false;
+
+// The dither goes into the setpoint, so the PI loop makes the current
+// follow it instead of taking it out as it would a DAC offset. The
+// triangle is as long as the decimation window and sums to zero in it;
+// 3mA is about 4 ADC LSBs of the current channel.
+#define DITHER_MA 3
+
+static const char *s_mode_names[LOAD_MODE_COUNT] = { "CC", "CR", "CP" };
+
+static void take_samples()
+{
+    uint16_t adc1[MAX_PAIRS_PER_TICK];
+    uint16_t adc2[MAX_PAIRS_PER_TICK];
+    int pairs = spi_sequencer_read_pairs(adc1, adc2, MAX_PAIRS_PER_TICK);
+    if (pairs == 0) return;
+    uint32_t now_us = time_us_32();
+
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+    for (int i = 0; i < pairs; i++) {
+        sum1 += adc1[i];
+        sum2 += adc2[i];
+    }
+
+    s_current_ma = (int32_t)(sum1 / pairs) * LOAD_CURRENT_FULL_SCALE_MA / AD7887_MAX_VALUE;
+    s_voltage_mv = (int32_t)(sum2 / pairs) * LOAD_VOLTAGE_FULL_SCALE_MV / AD7887_MAX_VALUE;
+    s_pairs += pairs;
+
+    if (energy_add_samples(adc1, adc2, pairs, now_us, s_voltage_mv)) {
+        transient_stop();
+        s_target = 0;
+    }
+
+    if (s_os_ratio != s_os_ratio_request) {
+        s_os_ratio = s_os_ratio_request;
+        oversample_init(&s_current_os, s_os_ratio);
+        oversample_init(&s_voltage_os, s_os_ratio);
+    }
+    for (int i = 0; i < pairs; i++) {
+        if (oversample_add(&s_current_os, adc1[i])) s_current_fine = s_current_os.value;
+        if (oversample_add(&s_voltage_os, adc2[i])) s_voltage_fine = s_voltage_os.value;
+    }
+
+    // transient capture takes every sample, not the means
+    if (transient_is_running()) {
+        uint16_t voltage_mv[MAX_PAIRS_PER_TICK];
+        for (int i = 0; i < pairs; i++) {
+            voltage_mv[i] = (uint16_t)((uint32_t)adc2[i] * LOAD_VOLTAGE_FULL_SCALE_MV / AD7887_MAX_VALUE);
+        }
+        transient_add_samples(voltage_mv, pairs, now_us);
+    }
+}
+
+static bool control_tick(repeating_timer_t *timer)
+{
+    take_samples();
+
+    int32_t dither = 0;
+
+    // transient steps are not slew limited, their edges are under test
+    if (transient_is_running()) {
+        s_setpoint_ma = transient_next_setpoint_ma();
+    }
+    else {
+        int32_t demand = load_loop_demand_ma(s_mode, s_target, s_voltage_mv);
+        s_setpoint_ma = load_loop_slew(s_setpoint_ma, demand);
+        if (s_dither && s_setpoint_ma > DITHER_MA) dither = oversample_dither(&s_current_os, DITHER_MA);
+    }
+
+    s_dac_value = load_loop_step(&s_loop, s_setpoint_ma + dither, s_current_ma);
+    spi_sequencer_set_dac(s_dac_value);
+
+    telemetry_record_t record;
+    record.time_us = time_us_32();
+    record.current_ma = (uint16_t)s_current_ma;
+    record.voltage_mv = (uint16_t)s_voltage_mv;
+    record.setpoint_ma = (uint16_t)s_setpoint_ma;
+    record.dac_value = s_dac_value;
+    telemetry_push(&record);
+    return true;
+}
+
+void load_control_init()
+{
+    oversample_init(&s_current_os, s_os_ratio);
+    oversample_init(&s_voltage_os, s_os_ratio);
+    spi_sequencer_set_dac(0);
+    spi_sequencer_start();
+    load_loop_reset(&s_loop);
+
+    // alarm pool interrupts the core which created it, its hardware alarm
+    // is any one left by the other users; negative period keeps the rate
+    // fixed, whatever the callback takes
+    s_alarm_pool = alarm_pool_create_with_unused_hardware_alarm(4);
+    alarm_pool_add_repeating_timer_us(s_alarm_pool, -LOAD_CONTROL_PERIOD_US, control_tick, NULL, &s_timer);
+}
+
+void load_control_set_mode(load_mode_t mode)
+{
+    if (mode >= LOAD_MODE_COUNT) return;
+    s_target = 0;
+    s_mode = mode;
+}
+
+void load_control_set_target(int32_t target)
+{
+    s_target = (target > 0) ? target : 0;
+}
+
+void load_control_set_oversampling(uint ratio, bool dither)
+{
+    s_os_ratio_request = MAX(1u, MIN(ratio, (uint)OVERSAMPLE_MAX_RATIO));
+    s_dither = dither;
+}
+
+void load_control_get_fine(load_fine_t *fine)
+{
+    fine->ratio = s_os_ratio;
+    fine->effective_bits = oversample_get_effective_bits(&s_current_os, s_dither);
+    fine->dither = s_dither;
+    fine->current_ma = oversample_to_units(s_current_fine, LOAD_CURRENT_FULL_SCALE_MA);
+    fine->voltage_mv = oversample_to_units(s_voltage_fine, LOAD_VOLTAGE_FULL_SCALE_MV);
+}
+
+void load_control_get_state(load_state_t *state)
+{
+    state->mode = s_mode;
+    state->target = s_target;
+    state->setpoint_ma = s_setpoint_ma;
+    state->current_ma = s_current_ma;
+    state->voltage_mv = s_voltage_mv;
+    state->dac_value = s_dac_value;
+    state->pairs = s_pairs;
+}
+
+const char *load_control_get_mode_name(load_mode_t mode)
+{
+    return (mode < LOAD_MODE_COUNT) ? s_mode_names[mode] : "??";
+}
@@ -0,0 +1,57 @@
+#ifndef _LOAD_CONTROL_H_
+#define _LOAD_CONTROL_H_
+
+#include <pico/stdlib.h>
+
+// the control loop runs at 10kHz
+#define LOAD_CONTROL_PERIOD_US 100
+
+typedef enum
+{
+    LOAD_MODE_CC,   // constant current, target in mA
+    LOAD_MODE_CR,   // constant resistance, target in mOhm
+    LOAD_MODE_CP,   // constant power, target in mW
+    LOAD_MODE_COUNT
+} load_mode_t;
+
+typedef struct
+{
+    load_mode_t mode;
+    int32_t target;
+    int32_t setpoint_ma;  // current the loop goes after, slew limited
+    int32_t current_ma;
+    int32_t voltage_mv;
+    uint16_t dac_value;
+    uint32_t pairs;       // ADC sample pairs taken by the loop so far
+} load_state_t;
+
+typedef struct
+{
+    uint ratio;           // samples per output, 1 is no oversampling
+    uint effective_bits;  // measured on host for the ratio and dither
+    bool dither;
+    float current_ma;     // last outputs of the oversampling stage
+    float voltage_mv;
+} load_fine_t;
+
+/// @brief Starts the sequencer and the control loop on the calling core.
+void load_control_init();
+
+/// @brief Changes the mode, the target goes to zero.
+void load_control_set_mode(load_mode_t mode);
+
+/// @brief Sets the target in the units of the current mode.
+void load_control_set_target(int32_t target);
+
+/// @brief Sets the oversampling ratio, a power of two of 1..256, and
+/// the dither of the current setpoint, which works from 64x up.
+void load_control_set_oversampling(uint ratio, bool dither);
+
+/// @brief Returns the readings of the oversampling stage.
+void load_control_get_fine(load_fine_t *fine);
+
+void load_control_get_state(load_state_t *state);
+const char *load_control_get_mode_name(load_mode_t mode);
+
+// _LOAD_CONTROL_H_
+#endif
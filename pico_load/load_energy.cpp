@@ -0,0 +1,295 @@
+//
+// Energy and charge of a battery discharge test. The control loop gives
+// every sample pair to the integrator on core1, the sums of the ADC
+// current by voltage and of the ADC current are taken over the time of
+// each control period in 64-bit fixed point, the remainder of the
+// division by the pairs is carried, so nothing is lost between periods.
+// The totals are converted to mWh and mAh only when they are reported.
+//
+// The totals are checkpointed to EEPROM once a minute in two slots used
+// in turn, a test which was running at reset is resumed from the newer
+// valid slot.
+// SL (2025)
+//
+#include <stdio.h>
+#include <stddef.h>
+#include <hardware/sync.h>
+#include "board_config.h"
+#include "adc_ad7887.h"
+#include "eeprom_24cxx.h"
+#include "telemetry.h"
+#include "load_energy.h"
+
+// voltage stays below the cutoff for 100ms, load steps don't stop the test
+#define CUTOFF_TICKS 1000
+
+#define CHECKPOINT_MAGIC 0x45474C50 // "PLGE"
+#define CHECKPOINT_PERIOD_US (60 * 1000 * 1000)
+#define CHECKPOINT_SLOT_ADDRESS(slot) ((slot) * 0x40)
+#define EEPROM_WRITE_MS 5
+
+typedef enum
+{
+    REQUEST_NONE,
+    REQUEST_START,
+    REQUEST_STOP,
+    REQUEST_RESUME
+} energy_request_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint64_t power_sum;
+    uint64_t current_sum;
+    uint64_t elapsed_us;
+    int32_t cutoff_mv;
+    int32_t target;
+    uint8_t state;
+    uint8_t mode;
+    uint8_t reserved[5];
+    uint8_t checksum;
+} checkpoint_t;
+
+static_assert(sizeof(checkpoint_t) % EEPROM_BYTESPERPAGE == 0, "checkpoint is not in whole pages");
+
+// integrator of core1
+static energy_totals_t s_totals;
+static uint64_t s_power_rest;
+static uint64_t s_current_rest;
+static uint32_t s_last_us;
+static bool s_has_last;
+static uint32_t s_low_ticks;
+
+// core0 asks for the changes, core1 makes them
+static volatile energy_request_t s_request = REQUEST_NONE;
+static int32_t s_request_cutoff_mv;
+static energy_totals_t s_resume_totals;
+
+// copy of the totals for core0, odd sequence while it is written
+static volatile uint32_t s_published_sequence;
+static energy_totals_t s_published;
+
+// checkpoint state of core0
+static uint32_t s_checkpoint_sequence;
+static uint64_t s_last_checkpoint_us;
+static energy_state_t s_checkpoint_state = ENERGY_IDLE;
+
+static const char *s_state_names[] = { "idle", "running", "stopped", "cut off" };
+
+static void request(energy_request_t request)
+{
+    while (s_request != REQUEST_NONE) tight_loop_contents();
+    __dmb();
+    s_request = request;
+}
+
+void energy_start(int32_t cutoff_mv)
+{
+    s_request_cutoff_mv = MAX(cutoff_mv, 0);
+    request(REQUEST_START);
+}
+
+void energy_stop()
+{
+    request(REQUEST_STOP);
+}
+
+// returns true if a request is taken, the state may have changed
+static bool take_request()
+{
+    energy_request_t request = s_request;
+    if (request == REQUEST_NONE) return false;
+    __dmb();
+
+    if (request == REQUEST_START || request == REQUEST_RESUME) {
+        if (request == REQUEST_RESUME) s_totals = s_resume_totals;
+        else {
+            s_totals = {};
+            s_totals.cutoff_mv = s_request_cutoff_mv;
+        }
+        s_totals.state = ENERGY_RUNNING;
+        s_power_rest = 0;
+        s_current_rest = 0;
+        s_has_last = false;
+        s_low_ticks = 0;
+    }
+    else if (request == REQUEST_STOP && s_totals.state == ENERGY_RUNNING) {
+        s_totals.state = ENERGY_STOPPED;
+    }
+
+    __dmb();
+    s_request = REQUEST_NONE;
+    return true;
+}
+
+static void publish()
+{
+    s_published_sequence = s_published_sequence + 1;
+    __dmb();
+    s_published = s_totals;
+    __dmb();
+    s_published_sequence = s_published_sequence + 1;
+}
+
+bool energy_add_samples(const uint16_t *adc1, const uint16_t *adc2, int count,
+    uint32_t now_us, int32_t voltage_mv)
+{
+    // a stop is published at once, the integrator doesn't publish after it
+    if (take_request()) publish();
+    if (s_totals.state != ENERGY_RUNNING) return false;
+    if (count == 0) return false;
+
+    // the pairs taken at the start were converted before it
+    bool cut_off = false;
+    if (s_has_last) {
+        uint32_t power = 0;
+        uint32_t current = 0;
+        for (int i = 0; i < count; i++) {
+            power += (uint32_t)adc1[i] * adc2[i];
+            current += adc1[i];
+        }
+
+        // each pair stands for its part of the period
+        uint32_t period_us = now_us - s_last_us;
+        uint64_t power_us = (uint64_t)power * period_us + s_power_rest;
+        uint64_t current_us = (uint64_t)current * period_us + s_current_rest;
+        s_totals.power_sum += power_us / count;
+        s_totals.current_sum += current_us / count;
+        s_power_rest = power_us % count;
+        s_current_rest = current_us % count;
+        s_totals.elapsed_us += period_us;
+        s_totals.samples += count;
+
+        s_low_ticks = (voltage_mv < s_totals.cutoff_mv) ? s_low_ticks + 1 : 0;
+        if (s_low_ticks >= CUTOFF_TICKS) {
+            s_totals.state = ENERGY_CUT_OFF;
+            cut_off = true;
+        }
+    }
+
+    s_last_us = now_us;
+    s_has_last = true;
+    publish();
+    return cut_off;
+}
+
+void energy_get_totals(energy_totals_t *totals)
+{
+    uint32_t sequence;
+    do {
+        sequence = s_published_sequence;
+        __dmb();
+        *totals = s_published;
+        __dmb();
+    } while ((sequence & 1) != 0 || sequence != s_published_sequence);
+
+    // the stop is seen before core1 takes it
+    if (totals->state == ENERGY_RUNNING && s_request == REQUEST_STOP) {
+        totals->state = ENERGY_STOPPED;
+    }
+}
+
+float energy_get_mwh(const energy_totals_t *totals)
+{
+    // uW per the product of ADC values, uW by us to mWh
+    double uw_per_lsb = (double)LOAD_CURRENT_FULL_SCALE_MA * LOAD_VOLTAGE_FULL_SCALE_MV /
+        ((double)AD7887_MAX_VALUE * AD7887_MAX_VALUE);
+    return (float)(totals->power_sum * uw_per_lsb / 3.6e12);
+}
+
+float energy_get_mah(const energy_totals_t *totals)
+{
+    double ma_per_lsb = (double)LOAD_CURRENT_FULL_SCALE_MA / AD7887_MAX_VALUE;
+    return (float)(totals->current_sum * ma_per_lsb / 3.6e9);
+}
+
+const char *energy_get_state_name(energy_state_t state)
+{
+    return (state < count_of(s_state_names)) ? s_state_names[state] : "??";
+}
+
+static uint8_t compute_checksum(const checkpoint_t *checkpoint)
+{
+    const uint8_t *bytes = (const uint8_t *)checkpoint;
+    uint8_t sum = 0;
+    for (uint i = 0; i < offsetof(checkpoint_t, checksum); i++) sum += bytes[i];
+    return (uint8_t)~sum;
+}
+
+static bool read_checkpoint(uint slot, checkpoint_t *checkpoint)
+{
+    int len = eeprom_read_bytes(CHECKPOINT_SLOT_ADDRESS(slot), (uint8_t *)checkpoint, sizeof(checkpoint_t));
+    return len == sizeof(checkpoint_t) && checkpoint->magic == CHECKPOINT_MAGIC &&
+        checkpoint->checksum == compute_checksum(checkpoint);
+}
+
+static bool write_checkpoint(uint slot, checkpoint_t *checkpoint)
+{
+    // the chip takes one page per write cycle
+    uint8_t *bytes = (uint8_t *)checkpoint;
+    for (uint offset = 0; offset < sizeof(checkpoint_t); offset += EEPROM_BYTESPERPAGE) {
+        int len = eeprom_write_bytes(CHECKPOINT_SLOT_ADDRESS(slot) + offset, bytes + offset, EEPROM_BYTESPERPAGE);
+        if (len != EEPROM_BYTESPERPAGE) return false;
+        sleep_ms(EEPROM_WRITE_MS);
+    }
+    return true;
+}
+
+bool energy_restore(uint8_t *mode, int32_t *target)
+{
+    checkpoint_t slots[2];
+    bool valid[2];
+    for (uint slot = 0; slot < 2; slot++) valid[slot] = read_checkpoint(slot, &slots[slot]);
+    if (!valid[0] && !valid[1]) return false;
+
+    const checkpoint_t *newer = &slots[0];
+    if (!valid[0] || (valid[1] && (int32_t)(slots[1].sequence - slots[0].sequence) > 0)) newer = &slots[1];
+    s_checkpoint_sequence = newer->sequence;
+    if (newer->state != ENERGY_RUNNING) return false;
+
+    s_resume_totals = {};
+    s_resume_totals.power_sum = newer->power_sum;
+    s_resume_totals.current_sum = newer->current_sum;
+    s_resume_totals.elapsed_us = newer->elapsed_us;
+    s_resume_totals.cutoff_mv = newer->cutoff_mv;
+    request(REQUEST_RESUME);
+
+    s_checkpoint_state = ENERGY_RUNNING;
+    s_last_checkpoint_us = time_us_64();
+    *mode = newer->mode;
+    *target = newer->target;
+    return true;
+}
+
+void energy_checkpoint(uint8_t mode, int32_t target)
+{
+    energy_totals_t totals;
+    energy_get_totals(&totals);
+
+    // a test is written while it runs and once more when it ends, so it
+    // is not resumed, an idle state is not written at all
+    uint64_t now_us = time_us_64();
+    bool changed = totals.state != s_checkpoint_state;
+    bool due = totals.state == ENERGY_RUNNING && now_us - s_last_checkpoint_us >= CHECKPOINT_PERIOD_US;
+    if (!(changed || due) || totals.state == ENERGY_IDLE) return;
+
+    checkpoint_t checkpoint = {};
+    checkpoint.magic = CHECKPOINT_MAGIC;
+    checkpoint.sequence = s_checkpoint_sequence + 1;
+    checkpoint.power_sum = totals.power_sum;
+    checkpoint.current_sum = totals.current_sum;
+    checkpoint.elapsed_us = totals.elapsed_us;
+    checkpoint.cutoff_mv = totals.cutoff_mv;
+    checkpoint.target = target;
+    checkpoint.state = (uint8_t)totals.state;
+    checkpoint.mode = mode;
+    checkpoint.checksum = compute_checksum(&checkpoint);
+
+    s_checkpoint_state = totals.state;
+    s_last_checkpoint_us = now_us;
+    if (write_checkpoint(checkpoint.sequence % 2, &checkpoint)) {
+        s_checkpoint_sequence = checkpoint.sequence;
+    }
+    else if (!telemetry_is_streaming()) printf("energy checkpoint is not written\n");
+}
@@ -0,0 +1,53 @@
+#ifndef _LOAD_ENERGY_H_
+#define _LOAD_ENERGY_H_
+
+#include <pico/stdlib.h>
+
+typedef enum
+{
+    ENERGY_IDLE,
+    ENERGY_RUNNING,
+    ENERGY_STOPPED,     // stopped by the host
+    ENERGY_CUT_OFF      // stopped by the cutoff voltage
+} energy_state_t;
+
+typedef struct
+{
+    energy_state_t state;
+    uint64_t power_sum;     // ADC current by ADC voltage by us
+    uint64_t current_sum;   // ADC current by us
+    uint64_t elapsed_us;
+    uint32_t samples;       // sample pairs, wraps
+    int32_t cutoff_mv;      // 0 is no cutoff
+} energy_totals_t;
+
+/// @brief Starts a new test from zero totals.
+/// @param cutoff_mv Test stops when the voltage stays below it, 0 never.
+void energy_start(int32_t cutoff_mv);
+void energy_stop();
+
+/// @brief Integrates the sample pairs of one control period, called by
+/// the control loop only.
+/// @param now_us Time of the period, the pairs cover the time since the
+/// previous period.
+/// @param voltage_mv Mean voltage of the period for the cutoff.
+/// @return True if the test has just been cut off.
+bool energy_add_samples(const uint16_t *adc1, const uint16_t *adc2, int count,
+    uint32_t now_us, int32_t voltage_mv);
+
+void energy_get_totals(energy_totals_t *totals);
+float energy_get_mwh(const energy_totals_t *totals);
+float energy_get_mah(const energy_totals_t *totals);
+const char *energy_get_state_name(energy_state_t state);
+
+/// @brief Resumes the test of the EEPROM checkpoint if it was running.
+/// @return True if the test is resumed, the mode and the target of the
+/// checkpoint are given back.
+bool energy_restore(uint8_t *mode, int32_t *target);
+
+/// @brief Writes the totals to EEPROM once a minute while the test runs
+/// and once more when it ends, called by core0.
+void energy_checkpoint(uint8_t mode, int32_t target);
+
+// _LOAD_ENERGY_H_
+#endif
@@ -0,0 +1,78 @@
+//
+// Fixed-point arithmetic of the load control loop: the current demand of
+// the modes, the setpoint slew limit and the PI step with anti-windup.
+// There is no hardware here, so the host tests run it on a simulated
+// MOSFET and shunt.
+// SL (2025)
+//
+#include "board_config.h"
+#include "dac_mcp4921.h"
+#include "load_loop.h"
+
+// PI gains in DAC values per mA, Q8 fixed point
+#define CONTROL_KP_Q8 64
+#define CONTROL_KI_Q8 8
+#define INTEGRAL_MAX ((int32_t)MCP4921_MAX_VALUE << 8)
+
+// 50mA per ms
+#define SLEW_MA_PER_TICK 5
+
+// power demand is not computed from the noise of a disconnected input
+#define MIN_POWER_VOLTAGE_MV 500
+
+static inline int32_t clamp(int32_t value, int32_t min, int32_t max)
+{
+    return value < min ? min : (value > max ? max : value);
+}
+
+void load_loop_reset(load_loop_t *loop)
+{
+    loop->integral = 0;
+}
+
+int32_t load_loop_demand_ma(load_mode_t mode, int32_t target, int32_t voltage_mv)
+{
+    int32_t demand = 0;
+
+    switch (mode) {
+        case LOAD_MODE_CC:
+            demand = target;
+            break;
+
+        case LOAD_MODE_CR:
+            demand = (target > 0) ? (int32_t)((int64_t)voltage_mv * 1000 / target) : 0;
+            break;
+
+        case LOAD_MODE_CP:
+            if (voltage_mv >= MIN_POWER_VOLTAGE_MV) {
+                demand = (int32_t)((int64_t)target * 1000 / voltage_mv);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return clamp(demand, 0, LOAD_MAX_CURRENT_MA);
+}
+
+int32_t load_loop_slew(int32_t setpoint_ma, int32_t demand_ma)
+{
+    return clamp(demand_ma, setpoint_ma - SLEW_MA_PER_TICK, setpoint_ma + SLEW_MA_PER_TICK);
+}
+
+uint16_t load_loop_step(load_loop_t *loop, int32_t setpoint_ma, int32_t current_ma)
+{
+    int32_t error = setpoint_ma - current_ma;
+    int32_t output = (CONTROL_KP_Q8 * error + loop->integral) >> 8;
+
+    // anti-windup, the integral stays while the output is clamped and
+    // the error would drive it further out
+    bool high = output >= MCP4921_MAX_VALUE && error > 0;
+    bool low = output <= 0 && error < 0;
+    if (!high && !low) {
+        loop->integral = clamp(loop->integral + CONTROL_KI_Q8 * error, 0, INTEGRAL_MAX);
+    }
+
+    return (uint16_t)clamp(output, 0, MCP4921_MAX_VALUE);
+}
@@ -0,0 +1,26 @@
+#ifndef _LOAD_LOOP_H_
+#define _LOAD_LOOP_H_
+
+#include <pico/stdlib.h>
+#include "load_control.h"
+
+// state of the PI loop, the integral is the DAC value in Q8 fixed point
+typedef struct
+{
+    int32_t integral;
+} load_loop_t;
+
+void load_loop_reset(load_loop_t *loop);
+
+/// @brief Returns the current the target of the mode asks for at the
+/// sensed voltage, limited to the load maximum.
+int32_t load_loop_demand_ma(load_mode_t mode, int32_t target, int32_t voltage_mv);
+
+/// @brief Moves the setpoint towards the demand by the slew rate limit.
+int32_t load_loop_slew(int32_t setpoint_ma, int32_t demand_ma);
+
+/// @brief One PI step from the sensed current to the DAC value.
+uint16_t load_loop_step(load_loop_t *loop, int32_t setpoint_ma, int32_t current_ma);
+
+// _LOAD_LOOP_H_
+#endif
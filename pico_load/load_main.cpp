@@ -7,26 +7,49 @@
 #include "dac_mcp4921.h"
 #include "adc_ad7887.h"
 #include "eeprom_24cxx.h"
-#include "encoder.h"
+#include "encoder_service.h"
+#include "input.h"
+#include "spi_bus.h"
+#include "spi_sequencer.h"
+#include "load_control.h"
+#include "telemetry.h"
+#include "load_transient.h"
+#include "load_energy.h"
 
-int g_count;
+char g_title[20];
 char g_buffer[100];
 
 static void core1_entry(); 
+static void process_events_until(absolute_time_t until);
+static void print_stats(const telemetry_stats_t *stats);
+static void print_fine(const load_fine_t *fine);
+static void print_energy(const energy_totals_t *totals);
+static void restore_energy_test();
+static void process_transient_capture();
+#ifdef LOAD_BENCHMARK
+static void run_benchmark();
+#endif
 
-#define DAC_MAX_VALUE MCP4921_MAX_VALUE
-#define DAC_MAX_VOLTS 1.58 // measured max voltage after divider
-#define DAC_VOLT_STEP 0.02
-#define ADC_MAX_VOLTS 3.3
+// core0 drains the telemetry ring this often, it holds 100ms of records
+#define TELEMETRY_POLL_MS 1
 
-static uint16_t _adc1_value;
-static uint16_t _adc2_value;
+#define HOST_LINE_SIZE 32
+static char _host_line[HOST_LINE_SIZE];
+static int _host_line_length = 0;
+static bool _print_stats = false;
+
+// encoder step and maximum of the target in each mode
+static const int32_t _target_steps[LOAD_MODE_COUNT] = { 10, 100, 100 }; // mA, mOhm, mW
+static const int32_t _target_units_max[LOAD_MODE_COUNT] = { LOAD_MAX_CURRENT_MA, 99900, 30000 };
+static const char *_target_units[LOAD_MODE_COUNT] = { "mA", "mR", "mW" };
 
 static int _encoder_value;
+static load_mode_t _encoder_mode = LOAD_MODE_CC;
 #define ENCODER_MIN_VALUE 0
-#define ENCODER_MAX_VALUE ((int)(DAC_MAX_VOLTS / DAC_VOLT_STEP))
 
-static int _measures_per_second = 0;
+#ifdef LOAD_BENCHMARK
+static volatile uint32_t _adc_value_sink;
+#endif
 
 int main() 
 {
@@ -34,80 +57,310 @@ int main()
     sleep_ms(500);
 
     eeprom_init();
-    encoder_init();
+    encoder_init(ENCODER_S1_PIN);
 
     board_led_init(); 
     board_display_init(); 
 
-    // DAC and ADC use the same SPI instance
+    // button events carry the GPIO number as the key code
+    input_init();
+    input_register_key(BUTTON_1_PIN, BUTTON_1_PIN, true, false);
+
+    // DAC and ADC use the same SPI bus
     mcp4921_init(); 
     ad7887_init();
+    spi_sequencer_init();
+    restore_energy_test();
+
+#ifdef LOAD_BENCHMARK
+    run_benchmark();
+#endif
 
     multicore_launch_core1(core1_entry);
 
     const int cycle_ms = 200; 
     while(true) {
 
-        //int dac_per_step = DAC_MAX_VALUE / (int)(DAC_MAX_VOLTS / DAC_VOLT_STEP); 
-        //int dac_value = std::min(n * dac_per_step, DAC_MAX_VALUE);
-        //float dac_volts = dac_value * DAC_MAX_VOLTS / DAC_MAX_VALUE;
-        //mcp4921_write_dac(dac_value); 
+        load_state_t state;
+        load_control_get_state(&state);
 
-        float adc1_volts = ad7887_convert_adc_to_volts(_adc1_value, ADC_MAX_VOLTS);
-        float adc2_volts = ad7887_convert_adc_to_volts(_adc2_value, ADC_MAX_VOLTS);
+        sprintf(g_title, "%s %d%s", load_control_get_mode_name(state.mode), 
+            (int)state.target, _target_units[state.mode]);
 
-        sprintf(g_buffer, "%.2f %.2f", adc1_volts, adc2_volts);
-        g_count = _measures_per_second;
+        // the test report is sent once when the test ends
+        static energy_state_t _energy_state = ENERGY_IDLE;
+        energy_totals_t totals;
+        energy_checkpoint((uint8_t)state.mode, state.target);
+        energy_get_totals(&totals);
+        if (totals.state == ENERGY_RUNNING) {
+            sprintf(g_title, "%.0fmAh %.2fWh", energy_get_mah(&totals), energy_get_mwh(&totals) * 1e-3f);
+        }
+        else if (totals.state != _energy_state && !telemetry_is_streaming()) print_energy(&totals);
+        _energy_state = totals.state;
+
+        // display shows the means of its interval, or the last readings
+        // of the oversampling stage when it is on
+        load_fine_t fine;
+        load_control_get_fine(&fine);
+        telemetry_stats_t stats;
+        if (telemetry_take_stats(&stats)) {
+            if (fine.ratio == 1) {
+                sprintf(g_buffer, "%.2f %.2f", stats.current_ma.mean * 1e-3f, stats.voltage_mv.mean * 1e-3f);
+            }
+            if (_print_stats && !telemetry_is_streaming()) print_stats(&stats);
+        }
+        if (fine.ratio > 1) {
+            sprintf(g_buffer, "%.3f %.3f", fine.current_ma * 1e-3f, fine.voltage_mv * 1e-3f);
+            if (_print_stats && !telemetry_is_streaming()) print_fine(&fine);
+        }
+
+        if (transient_is_running()) process_transient_capture();
 
         // display update lasts 15ms
         board_display_repaint();
 
         board_led_set(true); 
-        sleep_ms(cycle_ms / 2);
+        process_events_until(make_timeout_time_ms(cycle_ms / 2));
         board_led_set(false); 
-        sleep_ms(cycle_ms / 2);
+        process_events_until(make_timeout_time_ms(cycle_ms / 2));
     }
 
     return 0;
 }
 
-static void process_encoder_changes()
+static void print_stats(const telemetry_stats_t *stats)
+{
+    const telemetry_channel_stats_t *i = &stats->current_ma;
+    const telemetry_channel_stats_t *v = &stats->voltage_mv;
+    printf("mA %.1f %d %d %.1f mV %.1f %d %d %.1f n %u lost %u\n",
+        i->mean, (int)i->min, (int)i->max, i->rms,
+        v->mean, (int)v->min, (int)v->max, v->rms,
+        (uint)stats->count, (uint)stats->dropped);
+}
+
+static void print_fine(const load_fine_t *fine)
+{
+    printf("oversample %u%s bits %u mA %.2f mV %.2f\n", fine->ratio, fine->dither ? " dither" : "",
+        fine->effective_bits, fine->current_ma, fine->voltage_mv);
+}
+
+static void print_energy(const energy_totals_t *totals)
+{
+    float hours = totals->elapsed_us * (1.0f / 3.6e9f);
+    printf("energy %s %.1fmWh %.2fmAh time %.3fh", energy_get_state_name(totals->state),
+        energy_get_mwh(totals), energy_get_mah(totals), hours);
+    if (hours > 0) printf(" mean %.1fmW %.1fmA", energy_get_mwh(totals) / hours, energy_get_mah(totals) / hours);
+    printf(" cutoff %dmV pairs %u\n", (int)totals->cutoff_mv, (uint)totals->samples);
+}
+
+// A discharge test which was running at reset goes on with the mode
+// and the target it had.
+static void restore_energy_test()
+{
+    uint8_t mode;
+    int32_t target;
+    if (!energy_restore(&mode, &target) || mode >= LOAD_MODE_COUNT) return;
+
+    load_control_set_mode((load_mode_t)mode);
+    load_control_set_target(target);
+    _encoder_mode = (load_mode_t)mode;
+    _encoder_value = target / _target_steps[mode];
+}
+
+// Takes the transient capture if there is one, shows its summary and
+// sends the waveform with the summary to USB.
+static void process_transient_capture()
+{
+    static transient_capture_t _capture;
+    if (!transient_take_capture(&_capture)) return;
+
+    transient_summary_t summary;
+    transient_summarize(&_capture, &summary);
+    sprintf(g_title, "TR%c %dmV", _capture.rising ? '+' : '-', (int)summary.droop_mv);
+    sprintf(g_buffer, "%d%% %dus", (int)summary.overshoot_pct, (int)summary.settling_us);
+
+    if (telemetry_is_streaming()) return;
+
+    printf("transient %s start %d final %d droop %d overshoot %d%% settling %dus\n",
+        _capture.rising ? "rising" : "falling",
+        (int)summary.start_mv, (int)summary.final_mv, (int)summary.droop_mv,
+        (int)summary.overshoot_pct, (int)summary.settling_us);
+
+    // the edge is the setpoint change, the DAC takes it one sequencer frame later
+    printf("waveform mV, %.2fus per sample, setpoint edge at %d, DAC one frame later\n",
+        _capture.sample_us, TRANSIENT_PRE_SAMPLES);
+    for (int i = 0; i < TRANSIENT_SAMPLES; i++) {
+        printf((i % 16 == 15) ? "%d\n" : "%d ", _capture.voltage_mv[i]);
+    }
+}
+
+// Host commands are lines: STREAM ON|OFF for the binary records,
+// STATS ON|OFF for a text line of statistics per display interval,
+// TRANSIENT low_ma high_ma hz duty and TRANSIENT OFF for the
+// transient test, OVERSAMPLE ratio [DITHER] for the oversampling stage
+// where ratio 1 turns it off, ENERGY START [cutoff_mv], ENERGY STOP and
+// ENERGY for the discharge test and its report.
+static void execute_host_line(const char *line)
+{
+    int low_ma, high_ma, hz, duty, ratio, cutoff_mv = 0;
+    char option[8] = "";
+    if (sscanf(line, "OVERSAMPLE %d %7s", &ratio, option) >= 1) {
+        load_control_set_oversampling((uint)MAX(ratio, 1), strcasecmp(option, "DITHER") == 0);
+    }
+    else if (strncasecmp(line, "ENERGY START", 12) == 0) {
+        sscanf(line + 12, "%d", &cutoff_mv);
+        energy_start(cutoff_mv);
+    }
+    else if (strcasecmp(line, "ENERGY STOP") == 0) energy_stop();
+    else if (strcasecmp(line, "ENERGY") == 0) {
+        energy_totals_t totals;
+        energy_get_totals(&totals);
+        print_energy(&totals);
+    }
+    else if (sscanf(line, "TRANSIENT %d %d %d %d", &low_ma, &high_ma, &hz, &duty) == 4) {
+        transient_start(low_ma, high_ma, (uint)MAX(hz, 1), (uint)MAX(duty, 0));
+    }
+    else if (strcasecmp(line, "TRANSIENT OFF") == 0) transient_stop();
+    else if (strcasecmp(line, "STREAM ON") == 0) telemetry_set_streaming(true);
+    else if (strcasecmp(line, "STREAM OFF") == 0) telemetry_set_streaming(false);
+    else if (strcasecmp(line, "STATS ON") == 0) _print_stats = true;
+    else if (strcasecmp(line, "STATS OFF") == 0) _print_stats = false;
+}
+
+static void process_host_input()
 {
-    static int _last_raw = 0;
+    int ch;
+    while ((ch = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+        if (ch == '\r') continue;
+        if (ch == '\n') {
+            _host_line[_host_line_length] = 0;
+            execute_host_line(_host_line);
+            _host_line_length = 0;
+        }
+        else if (_host_line_length < HOST_LINE_SIZE - 1) {
+            _host_line[_host_line_length++] = (char)ch;
+        }
+    }
+}
+
+// Sleeps until the deadline handling the button events and the host
+// commands as they come, the telemetry ring is drained meanwhile.
+static void process_events_until(absolute_time_t until)
+{
+    input_event_t event;
+    while (!time_reached(until)) {
+        telemetry_poll();
+        process_host_input();
+
+        absolute_time_t poll_time = make_timeout_time_ms(TELEMETRY_POLL_MS);
+        if (input_wait_event_until(&event, absolute_time_min(poll_time, until))) {
+            if (event.key == BUTTON_1_PIN && event.type == INPUT_KEY_DOWN) {
+                load_state_t state;
+                load_control_get_state(&state);
+                load_control_set_mode((load_mode_t)((state.mode + 1) % LOAD_MODE_COUNT));
+            }
+        }
+    }
+}
 
-    int raw = encoder_get_count();
-    if (raw == _last_raw) return;
+static void process_encoder_changes()
+{
+    // mode change or the energy test cutoff has brought the target to zero
+    load_state_t state;
+    load_control_get_state(&state);
+    if (state.mode != _encoder_mode || state.target == 0) {
+        _encoder_mode = state.mode;
+        _encoder_value = 0;
+    }
 
-    int delta = raw - _last_raw;
-    _last_raw = raw;
+    // steps are sampled by the encoder timer, fast spins give big steps
+    int delta = encoder_take_steps();
+    if (delta == 0) return;
 
+    int max_value = _target_units_max[state.mode] / _target_steps[state.mode];
     int adjusted = _encoder_value + delta;
-    _encoder_value = std::max(ENCODER_MIN_VALUE, std::min(ENCODER_MAX_VALUE, adjusted));
+    _encoder_value = std::max(ENCODER_MIN_VALUE, std::min(max_value, adjusted));
+    load_control_set_target(_encoder_value * _target_steps[state.mode]);
 }
 
 static void core1_entry() 
 {
-    int measure_count = 0;
-    uint32_t start_time = time_us_32();
+    // control loop interrupts this core, the encoder steps are taken meanwhile
+    load_control_init();
 
-    // this loop cycles at the speed of 15kHz
     while (true) { 
-
         process_encoder_changes();  
+        sleep_ms(1);
+    }
+}
 
-        mcp4921_write_dac(DAC_MAX_VALUE / 2); 
+#ifdef LOAD_BENCHMARK
 
-        _adc1_value = ad7887_read_adc(0); 
-        _adc2_value = ad7887_read_adc(1); 
+#define BENCHMARK_US (1000 * 1000)
 
-        measure_count += 1;
+// The loop of one DAC write and both ADC channels as it was, the DAC
+// output settles by the sleep after the write.
+static int measure_blocking_loop()
+{
+    int count = 0;
+    absolute_time_t until = make_timeout_time_us(BENCHMARK_US);
+    while (!time_reached(until)) {
+        mcp4921_write_dac(MCP4921_MAX_VALUE / 2);
+        spi_bus_wait_idle();
+        sleep_us(10);
+        _adc_value_sink += ad7887_read_adc(0);
+        _adc_value_sink += ad7887_read_adc(1);
+        count += 1;
+    }
+    return count;
+}
 
-        uint32_t stop_time = time_us_32();
-        int elapsed = (int)((stop_time - start_time) * 1e-6f);
-        if (elapsed > 0) {
-            _measures_per_second = measure_count;
-            measure_count = 0;
-            start_time = stop_time;
-        }
+// The same loop with the voltage channel read while the DAC settles.
+static int measure_pipelined_loop()
+{
+    int count = 0;
+    absolute_time_t until = make_timeout_time_us(BENCHMARK_US);
+    while (!time_reached(until)) {
+        mcp4921_write_dac(MCP4921_MAX_VALUE / 2);
+        _adc_value_sink += ad7887_read_adc(1);
+        mcp4921_wait_settled();
+        _adc_value_sink += ad7887_read_adc(0);
+        count += 1;
     }
+    return count;
 }
+
+// Sample pairs per second of the DMA sequencer.
+static int measure_sequencer()
+{
+    const int max_pairs = 64;
+    uint16_t adc1[max_pairs];
+    uint16_t adc2[max_pairs];
+
+    int count = 0;
+    spi_sequencer_start();
+    absolute_time_t until = make_timeout_time_us(BENCHMARK_US);
+    while (!time_reached(until)) {
+        count += spi_sequencer_read_pairs(adc1, adc2, max_pairs);
+    }
+    spi_sequencer_stop();
+    return count;
+}
+
+// Prints the loop rates of the DAC and both ADC channels, forever.
+static void run_benchmark()
+{
+    while (true) {
+        int blocking = measure_blocking_loop();
+        int pipelined = measure_pipelined_loop();
+        int sequenced = measure_sequencer();
+        printf("loops per second: blocking %d pipelined %d sequencer %d\n",
+            blocking, pipelined, sequenced);
+
+        sprintf(g_title, "B%d P%d", blocking / 1000, pipelined / 1000);
+        sprintf(g_buffer, "S%d", sequenced / 1000);
+        board_display_repaint();
+    }
+}
+
+#endif
@@ -0,0 +1,176 @@
+//
+// Transient test of the electronic load. The control loop alternates the
+// current between two setpoints, a whole number of its periods each, so
+// the edges are as exact as the loop timer. The voltage samples of the
+// sequencer go to a ring, at a current edge the ring keeps its
+// pre-trigger samples and is filled up with the post-trigger ones, then
+// the capture waits until core0 takes it. The captures take the rising
+// and the falling edges by turns. The sample time comes from the
+// times of the sample batches and the pairs in them, a batch holds the
+// pairs converted since the previous one.
+// SL (2025)
+//
+#include <stdlib.h>
+#include <hardware/sync.h>
+#include "board_config.h"
+#include "load_control.h"
+#include "load_transient.h"
+
+// final voltage is the mean of the last samples of the capture
+#define FINAL_SAMPLES 64
+
+// settled within 2% of the voltage step, but not less than the noise
+#define SETTLE_BAND_PERCENT 2
+#define MIN_SETTLE_BAND_MV 10
+
+enum
+{
+    CAPTURE_ARMING,
+    CAPTURE_ARMED,
+    CAPTURE_TRIGGERED,
+    CAPTURE_DONE
+};
+
+static volatile bool s_is_running = false;
+static int32_t s_low_ma;
+static int32_t s_high_ma;
+static uint32_t s_period_ticks;
+static uint32_t s_high_ticks;
+static uint32_t s_tick;
+
+// written by the control loop, by core0 only when done
+static uint16_t s_ring[TRANSIENT_SAMPLES];
+static uint32_t s_written;
+static uint32_t s_trigger_written;
+static uint32_t s_batch_us;
+static uint32_t s_trigger_us;
+static uint32_t s_done_us;
+static uint32_t s_post_pairs;
+static volatile int s_capture_state = CAPTURE_ARMING;
+static bool s_capture_rising;
+
+void transient_start(int32_t low_ma, int32_t high_ma, uint hz, uint duty)
+{
+    s_is_running = false;
+    __dmb();
+
+    uint32_t ticks_per_second = 1000000 / LOAD_CONTROL_PERIOD_US;
+    s_low_ma = MAX(0, MIN(low_ma, LOAD_MAX_CURRENT_MA));
+    s_high_ma = MAX(0, MIN(high_ma, LOAD_MAX_CURRENT_MA));
+    s_period_ticks = MAX(2u, ticks_per_second / MAX(hz, 1u));
+    s_high_ticks = MAX(1u, MIN(s_period_ticks - 1, s_period_ticks * duty / 100));
+    s_tick = 0;
+    s_capture_rising = true;
+    s_capture_state = CAPTURE_ARMING;
+
+    __dmb();
+    s_is_running = true;
+}
+
+void transient_stop()
+{
+    s_is_running = false;
+}
+
+bool transient_is_running()
+{
+    return s_is_running;
+}
+
+void transient_add_samples(const uint16_t *voltage_mv, int count, uint32_t batch_us)
+{
+    if (s_capture_state == CAPTURE_ARMING) {
+        s_written = 0;
+        s_capture_state = CAPTURE_ARMED;
+    }
+
+    if (s_capture_state == CAPTURE_DONE) return;
+
+    // whole batches after the trigger, the last one may be taken in part
+    s_batch_us = batch_us;
+    if (s_capture_state == CAPTURE_TRIGGERED) s_post_pairs += count;
+
+    for (int i = 0; i < count; i++) {
+        s_ring[s_written % TRANSIENT_SAMPLES] = voltage_mv[i];
+        s_written += 1;
+
+        if (s_capture_state == CAPTURE_TRIGGERED &&
+            s_written - s_trigger_written == TRANSIENT_POST_SAMPLES) {
+            s_done_us = batch_us;
+            __dmb();
+            s_capture_state = CAPTURE_DONE;
+            return;
+        }
+    }
+}
+
+int32_t transient_next_setpoint_ma()
+{
+    // rising edge at the period start, falling edge after the high ticks,
+    // samples taken after it are the post-trigger ones
+    uint32_t edge_tick = s_capture_rising ? 0 : s_high_ticks;
+    if (s_tick == edge_tick && s_capture_state == CAPTURE_ARMED && s_written >= TRANSIENT_PRE_SAMPLES) {
+        s_trigger_written = s_written;
+        s_trigger_us = s_batch_us;
+        s_post_pairs = 0;
+        s_capture_state = CAPTURE_TRIGGERED;
+    }
+
+    int32_t setpoint = (s_tick < s_high_ticks) ? s_high_ma : s_low_ma;
+    s_tick = (s_tick + 1) % s_period_ticks;
+    return setpoint;
+}
+
+bool transient_take_capture(transient_capture_t *capture)
+{
+    if (s_capture_state != CAPTURE_DONE) return false;
+    __dmb();
+
+    uint32_t start = s_trigger_written - TRANSIENT_PRE_SAMPLES;
+    for (int i = 0; i < TRANSIENT_SAMPLES; i++) {
+        capture->voltage_mv[i] = s_ring[(start + i) % TRANSIENT_SAMPLES];
+    }
+    capture->sample_us = (float)(s_done_us - s_trigger_us) / s_post_pairs;
+    capture->rising = s_capture_rising;
+
+    s_capture_rising = !s_capture_rising;
+    __dmb();
+    s_capture_state = CAPTURE_ARMING;
+    return true;
+}
+
+static int32_t compute_mean(const uint16_t *values, int count)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < count; i++) sum += values[i];
+    return sum / count;
+}
+
+void transient_summarize(const transient_capture_t *capture, transient_summary_t *summary)
+{
+    const uint16_t *post = capture->voltage_mv + TRANSIENT_PRE_SAMPLES;
+    int32_t start_mv = compute_mean(capture->voltage_mv, TRANSIENT_PRE_SAMPLES);
+    int32_t final_mv = compute_mean(post + TRANSIENT_POST_SAMPLES - FINAL_SAMPLES, FINAL_SAMPLES);
+
+    // higher current pulls the voltage down by the step, the response may
+    // drop deeper before it settles, a falling edge is the same upwards
+    int32_t sign = capture->rising ? 1 : -1;
+    int32_t droop_mv = 0;
+    for (int i = 0; i < TRANSIENT_POST_SAMPLES; i++) {
+        droop_mv = MAX(droop_mv, sign * (start_mv - (int32_t)post[i]));
+    }
+
+    int32_t step_mv = sign * (start_mv - final_mv);
+    int32_t band_mv = MAX(abs(step_mv) * SETTLE_BAND_PERCENT / 100, MIN_SETTLE_BAND_MV);
+
+    int settled = 0;
+    for (int i = 0; i < TRANSIENT_POST_SAMPLES; i++) {
+        if (abs((int32_t)post[i] - final_mv) > band_mv) settled = i + 1;
+    }
+
+    summary->start_mv = start_mv;
+    summary->final_mv = final_mv;
+    summary->droop_mv = droop_mv;
+    summary->overshoot_pct = (step_mv != 0) ? (droop_mv - step_mv) * 100 / abs(step_mv) : 0;
+    summary->settling_us = (uint32_t)(settled * capture->sample_us);
+}
@@ -0,0 +1,55 @@
+#ifndef _LOAD_TRANSIENT_H_
+#define _LOAD_TRANSIENT_H_
+
+#include <pico/stdlib.h>
+
+// samples of the voltage before and after the current edge
+#define TRANSIENT_PRE_SAMPLES 128
+#define TRANSIENT_POST_SAMPLES 896
+#define TRANSIENT_SAMPLES (TRANSIENT_PRE_SAMPLES + TRANSIENT_POST_SAMPLES)
+
+typedef struct
+{
+    uint16_t voltage_mv[TRANSIENT_SAMPLES]; // the edge is at TRANSIENT_PRE_SAMPLES
+    float sample_us;                        // time between the samples
+    bool rising;                            // edge to the high current
+} transient_capture_t;
+
+typedef struct
+{
+    int32_t start_mv;       // mean before the edge
+    int32_t final_mv;       // mean at the end of the capture
+    int32_t droop_mv;       // deepest excursion from the start, a drop at a rising edge
+    int32_t overshoot_pct;  // deepest excursion beyond the final step
+    uint32_t settling_us;   // time to stay within the band around the final
+} transient_summary_t;
+
+/// @brief Starts alternating the current between two setpoints.
+/// @param low_ma Current of the low part of the period.
+/// @param high_ma Current of the high part of the period.
+/// @param hz Periods per second.
+/// @param duty Percent of the period at the high current.
+void transient_start(int32_t low_ma, int32_t high_ma, uint hz, uint duty);
+void transient_stop();
+bool transient_is_running();
+
+/// @brief Returns the setpoint of the current control period, called by
+/// the control loop once per period. Also triggers the capture, at the
+/// rising and the falling edge by turns. The edge marks the setpoint change,
+/// the DAC takes it with the next sequencer frame.
+int32_t transient_next_setpoint_ma();
+
+/// @brief Takes the voltage samples into the capture, called by the
+/// control loop before transient_next_setpoint_ma().
+/// @param batch_us Time the samples are read, the same point of every
+/// control period.
+void transient_add_samples(const uint16_t *voltage_mv, int count, uint32_t batch_us);
+
+/// @brief Copies the completed capture and arms the next one.
+/// @return False if the capture is not completed yet.
+bool transient_take_capture(transient_capture_t *capture);
+
+void transient_summarize(const transient_capture_t *capture, transient_summary_t *summary);
+
+// _LOAD_TRANSIENT_H_
+#endif
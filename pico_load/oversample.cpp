@@ -0,0 +1,26 @@
+//
+// Oversampling and decimation of the ADC sample stream. Averaging 4^n
+// samples with noise of at least one LSB gives n more bits at a rate
+// 4^n times lower. The noise may come from the setpoint dither of the
+// load.
+// SL (2025)
+//
+#include "oversample.h"
+
+void oversample_init(oversample_t *os, uint ratio)
+{
+    uint bits = 0;
+    while (bits < 8 && (2u << bits) <= MIN(ratio, OVERSAMPLE_MAX_RATIO)) bits++;
+
+    os->sum = 0;
+    os->count = 0;
+    os->ratio_bits = bits;
+    os->value = 0;
+    os->outputs = 0;
+}
+
+uint oversample_get_effective_bits(const oversample_t *os, bool dither)
+{
+    bool dithered = dither && (1u << os->ratio_bits) >= OVERSAMPLE_DITHER_MIN_RATIO;
+    return dithered ? OVERSAMPLE_DITHER_BITS : OVERSAMPLE_ADC_BITS;
+}
@@ -0,0 +1,69 @@
+#ifndef _OVERSAMPLE_H_
+#define _OVERSAMPLE_H_
+
+#include <pico/stdlib.h>
+
+// Outputs are on the 16-bit scale of the 12-bit ADC full scale, 4 bits
+// below the ADC LSB are the most that 256x oversampling can resolve.
+#define OVERSAMPLE_ADC_BITS 12
+#define OVERSAMPLE_SCALE_BITS 4
+#define OVERSAMPLE_MAX_RATIO 256
+
+// shorter windows hold too few control periods for the dither triangle
+#define OVERSAMPLE_DITHER_MIN_RATIO 64
+#define OVERSAMPLE_DITHER_BITS 14
+
+typedef struct
+{
+    uint32_t sum;
+    uint32_t count;
+    uint32_t ratio_bits;    // log2 of the oversampling ratio
+    uint16_t value;         // last output, 16-bit scale
+    uint32_t outputs;       // outputs made so far
+} oversample_t;
+
+/// @brief Sets the ratio, rounded down to a power of two within 1..256.
+void oversample_init(oversample_t *os, uint ratio);
+
+/// @brief Returns the effective bits the host test measures for the stage,
+/// 14 with the dither from 64x up, the 12 of the ADC otherwise. A steady
+/// input without noise gains nothing from averaging.
+uint oversample_get_effective_bits(const oversample_t *os, bool dither);
+
+/// @brief Adds one ADC sample, makes an output once per ratio samples.
+/// @return True if a new output is made.
+inline bool oversample_add(oversample_t *os, uint16_t sample)
+{
+    os->sum += sample;
+    os->count += 1;
+    if (os->count < (1u << os->ratio_bits)) return false;
+
+    // decimation, the sum of 4^n samples has n more bits than one sample
+    os->value = (uint16_t)((os->sum << OVERSAMPLE_SCALE_BITS) >> os->ratio_bits);
+    os->sum = 0;
+    os->count = 0;
+    os->outputs += 1;
+    return true;
+}
+
+/// @brief Returns the dither for the next samples of the window.
+/// It is a triangle from +amplitude down to -amplitude and back once per
+/// decimation window, so it sums to zero in every output whatever the
+/// samples per control period, and spreads the samples over the codes.
+inline int32_t oversample_dither(const oversample_t *os, int32_t amplitude)
+{
+    if ((1u << os->ratio_bits) < OVERSAMPLE_DITHER_MIN_RATIO) return 0;
+    int32_t window = 1 << os->ratio_bits;
+    int32_t position = 4 * (int32_t)os->count - 2 * window;
+    int32_t distance = (position < 0) ? -position : position;
+    return amplitude * (distance - window) / window;
+}
+
+/// @brief Converts the 16-bit scale output to the units of the full scale.
+inline float oversample_to_units(uint16_t value, int32_t full_scale)
+{
+    return (float)value * full_scale / ((1u << (OVERSAMPLE_ADC_BITS + OVERSAMPLE_SCALE_BITS)) - (1u << OVERSAMPLE_SCALE_BITS));
+}
+
+// _OVERSAMPLE_H_
+#endif
@@ -0,0 +1,72 @@
+//
+// PIO SPI master of the bus shared by the MCP4921 DAC and the AD7887 ADC.
+// The program drives both chip selects itself, so transfers to different
+// chips go back to back without the CPU toggling pins in between.
+// SL (2025)
+//
+#include <hardware/clocks.h>
+#include "board_config.h"
+#include "spi_bus.h"
+#include "spi_bus.pio.h"
+
+#define SPI_BUS_PIO pio1
+
+#if BOARD_SPI_CS1_PIN != BOARD_SPI_CS2_PIN + 4
+#error "spi_bus.pio needs the CS1 pin 4 pins above the CS2 pin"
+#endif
+
+static PIO s_bus_pio = SPI_BUS_PIO;
+static uint s_bus_sm;
+static bool s_is_initialized = false;
+
+void spi_bus_init()
+{
+    if (s_is_initialized) return;
+
+    uint offset = pio_add_program(s_bus_pio, &spi_bus_program);
+    s_bus_sm = pio_claim_unused_sm(s_bus_pio, true);
+    spi_bus_program_init(s_bus_pio, s_bus_sm, offset, BOARD_SPI_CS2_PIN,
+        BOARD_SPI_SCK_PIN, BOARD_SPI_TX_PIN, BOARD_SPI_RX_PIN, BOARD_SPI_BAUDRATE);
+
+    s_is_initialized = true;
+}
+
+uint16_t spi_bus_transfer(uint chip, uint16_t data)
+{
+    pio_sm_put_blocking(s_bus_pio, s_bus_sm, spi_bus_make_word(chip, data, true));
+    return (uint16_t)pio_sm_get_blocking(s_bus_pio, s_bus_sm);
+}
+
+void spi_bus_write(uint chip, uint16_t data)
+{
+    spi_bus_write_async(chip, data);
+    spi_bus_wait_idle();
+}
+
+void spi_bus_write_async(uint chip, uint16_t data)
+{
+    pio_sm_put_blocking(s_bus_pio, s_bus_sm, spi_bus_make_word(chip, data, false));
+}
+
+void spi_bus_wait_idle()
+{
+    // the program stalls on the empty TX FIFO after the last word
+    uint32_t stall_mask = 1u << (PIO_FDEBUG_TXSTALL_LSB + s_bus_sm);
+    s_bus_pio->fdebug = stall_mask;
+    while (!(s_bus_pio->fdebug & stall_mask)) tight_loop_contents();
+}
+
+uint spi_bus_get_tx_level()
+{
+    return pio_sm_get_tx_fifo_level(s_bus_pio, s_bus_sm);
+}
+
+PIO spi_bus_get_pio()
+{
+    return s_bus_pio;
+}
+
+uint spi_bus_get_sm()
+{
+    return s_bus_sm;
+}
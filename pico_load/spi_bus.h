@@ -0,0 +1,51 @@
+#ifndef _SPI_BUS_H_
+#define _SPI_BUS_H_
+
+#include <pico/stdlib.h>
+#include <hardware/pio.h>
+#include "board_config.h"
+
+// Chips on the bus by their chip select pins.
+#define SPI_BUS_CS2_CHIP 0
+#define SPI_BUS_CS1_CHIP 1
+
+#define SPI_BUS_CHIP_LSB 16
+#define SPI_BUS_REPLY_BIT (1u << 17)
+
+// bus clocks of one transfer with its chip select and word setup
+#define SPI_BUS_TRANSFER_BITS 20
+#define SPI_BUS_TRANSFER_US \
+    ((SPI_BUS_TRANSFER_BITS * 1000000 + BOARD_SPI_BAUDRATE - 1) / BOARD_SPI_BAUDRATE)
+
+/// @brief Starts the PIO SPI master on the board SPI pins, second calls do nothing.
+void spi_bus_init();
+
+/// @brief Builds the FIFO word of one 16-bit transfer.
+/// @param chip SPI_BUS_CS1_CHIP or SPI_BUS_CS2_CHIP.
+/// @param data The 16-bit word sent to the chip.
+/// @param reply True to have the received 16 bits in the RX FIFO.
+inline uint32_t spi_bus_make_word(uint chip, uint16_t data, bool reply) {
+    return (reply ? SPI_BUS_REPLY_BIT : 0) | (chip << SPI_BUS_CHIP_LSB) | data;
+}
+
+/// @brief Sends the 16-bit word and returns the 16 bits received.
+uint16_t spi_bus_transfer(uint chip, uint16_t data);
+
+/// @brief Sends the 16-bit word and waits until it is out.
+void spi_bus_write(uint chip, uint16_t data);
+
+/// @brief Queues the 16-bit word, it waits for a place in the TX FIFO only.
+void spi_bus_write_async(uint chip, uint16_t data);
+
+/// @brief Waits until the words in the TX FIFO are out.
+void spi_bus_wait_idle();
+
+/// @brief Returns the words waiting in the TX FIFO, a word the program
+/// is sending already is not counted.
+uint spi_bus_get_tx_level();
+
+PIO spi_bus_get_pio();
+uint spi_bus_get_sm();
+
+// _SPI_BUS_H_
+#endif
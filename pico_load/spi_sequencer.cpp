@@ -0,0 +1,145 @@
+//
+// DMA sequencer of the SPI bus shared by the MCP4921 DAC and the AD7887 ADC.
+// One frame of bus words, the DAC word and 8 ADC words, is fed to the PIO
+// SPI master by a data DMA channel, a control channel then restarts it from
+// the frame start. The PIO program selects the chips itself and returns
+// the ADC replies only, which an RX channel takes to a ring buffer, so the
+// CPU is not involved until it reads the samples.
+//
+// The DAC output takes 4.5us to settle, so the first conversion after the
+// DAC word is of the voltage channel and the current channel is sampled
+// one ADC word later, when the output has settled.
+//
+// At 2MHz clock a bus word takes 76 PIO clocks of 8MHz, 9.5us, so the
+// 9-word frame gives about 93K samples, 46K pairs, per second.
+//
+// SL (2025)
+//
+#include <hardware/dma.h>
+#include "board_config.h"
+#include "spi_bus.h"
+#include "dac_mcp4921.h"
+#include "adc_ad7887.h"
+#include "spi_sequencer.h"
+
+#define SEQ_DAC_CHIP SPI_BUS_CS1_CHIP
+#define SEQ_ADC_CHIP SPI_BUS_CS2_CHIP
+
+#define ADC_WORDS_PER_FRAME 8
+#define FRAME_WORDS (1 + ADC_WORDS_PER_FRAME)
+
+// At 93K samples per second the ring lasts for 22ms.
+#define RING_SAMPLES 2048
+#define RING_BYTES (RING_SAMPLES * sizeof(uint16_t))
+#define RING_SIZE_BITS 12
+#define RING_TRANSFERS 0xffffffff
+
+static uint16_t s_ring[RING_SAMPLES] __attribute__((aligned(RING_BYTES)));
+static uint32_t s_frame[FRAME_WORDS];
+static const uint32_t *s_frame_start = s_frame;
+
+static uint s_control_channel;
+static uint s_data_channel;
+static uint s_rx_channel;
+static int s_read_index;
+static bool s_is_running;
+
+void spi_sequencer_init()
+{
+    spi_bus_init();
+
+    // AD7887 returns the conversion selected by the previous word, the
+    // last word of the frame selects channel 1 for the first sample after
+    // the DAC word, so each pair is channel 1 then channel 0
+    s_frame[0] = spi_bus_make_word(SEQ_DAC_CHIP, mcp4921_make_word(0), false);
+    for (int i = 0; i < ADC_WORDS_PER_FRAME; i++) {
+        uint16_t word = ad7887_make_control_word((i % 2 == 0) ? 0 : 1);
+        s_frame[1 + i] = spi_bus_make_word(SEQ_ADC_CHIP, word, true);
+    }
+
+    s_control_channel = dma_claim_unused_channel(true);
+    s_data_channel = dma_claim_unused_channel(true);
+    s_rx_channel = dma_claim_unused_channel(true);
+}
+
+void spi_sequencer_start()
+{
+    if (s_is_running) return;
+
+    PIO pio = spi_bus_get_pio();
+    uint sm = spi_bus_get_sm();
+
+    // RX channel takes the 16 reply bits of the FIFO words to the ring
+    dma_channel_config cfg = dma_channel_get_default_config(s_rx_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_ring(&cfg, true, RING_SIZE_BITS);
+    channel_config_set_dreq(&cfg, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(s_rx_channel, &cfg, s_ring, &pio->rxf[sm], RING_TRANSFERS, true);
+
+    // data channel feeds one frame to the FIFO and chains to control
+    cfg = dma_channel_get_default_config(s_data_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, true);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_dreq(&cfg, pio_get_dreq(pio, sm, true));
+    channel_config_set_chain_to(&cfg, s_control_channel);
+    dma_channel_configure(s_data_channel, &cfg, &pio->txf[sm], s_frame, FRAME_WORDS, false);
+
+    // control channel restarts the data channel from the frame start
+    cfg = dma_channel_get_default_config(s_control_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, false);
+    dma_channel_configure(s_control_channel, &cfg,
+        &dma_hw->ch[s_data_channel].al3_read_addr_trig, &s_frame_start, 1, false);
+
+    s_read_index = 0;
+    s_is_running = true;
+    dma_channel_start(s_data_channel);
+}
+
+void spi_sequencer_stop()
+{
+    if (!s_is_running) return;
+
+    // break the chain, so the frame being sent is the last one
+    dma_channel_config cfg = dma_get_channel_config(s_data_channel);
+    channel_config_set_chain_to(&cfg, s_data_channel);
+    dma_channel_set_config(s_data_channel, &cfg, false);
+    while (dma_channel_is_busy(s_control_channel) || dma_channel_is_busy(s_data_channel)) {
+        tight_loop_contents();
+    }
+
+    spi_bus_wait_idle();
+    dma_channel_abort(s_rx_channel);
+    s_is_running = false;
+}
+
+void spi_sequencer_set_dac(uint16_t data)
+{
+    s_frame[0] = spi_bus_make_word(SEQ_DAC_CHIP, mcp4921_make_word(data), false);
+}
+
+int spi_sequencer_read_pairs(uint16_t *adc1, uint16_t *adc2, int max_pairs)
+{
+    // only complete pairs are taken, the RX channel may be inside one
+    uintptr_t write_addr = dma_channel_hw_addr(s_rx_channel)->write_addr;
+    int write_index = (int)((write_addr - (uintptr_t)s_ring) / sizeof(uint16_t)) & ~1;
+
+    int pairs = 0;
+    while (s_read_index != write_index && pairs < max_pairs) {
+        adc2[pairs] = s_ring[s_read_index];
+        adc1[pairs] = s_ring[s_read_index + 1];
+        s_read_index = (s_read_index + 2) % RING_SAMPLES;
+        pairs += 1;
+    }
+
+    // rearm the RX channel after its 2^32 transfers are done
+    if (s_is_running && !dma_channel_is_busy(s_rx_channel)) {
+        dma_channel_set_trans_count(s_rx_channel, RING_TRANSFERS, true);
+    }
+
+    return pairs;
+}
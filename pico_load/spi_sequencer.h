@@ -0,0 +1,25 @@
+#ifndef _SPI_SEQUENCER_H_
+#define _SPI_SEQUENCER_H_
+
+#include <pico/stdlib.h>
+
+void spi_sequencer_init();
+
+/// @brief Starts the DMA sequence of DAC writes and ADC conversions.
+void spi_sequencer_start();
+
+/// @brief Stops the sequence at the end of its frame.
+void spi_sequencer_stop();
+
+/// @brief Sets the 12-bit value the DAC gets at the next frame.
+void spi_sequencer_set_dac(uint16_t data);
+
+/// @brief Takes the ADC samples converted since the last call.
+/// @param adc1 Receives the channel 0 samples.
+/// @param adc2 Receives the channel 1 samples.
+/// @param max_pairs Size of the receiving arrays.
+/// @return Number of the sample pairs taken.
+int spi_sequencer_read_pairs(uint16_t *adc1, uint16_t *adc2, int max_pairs);
+
+// _SPI_SEQUENCER_H_
+#endif
@@ -0,0 +1,171 @@
+//
+// Telemetry of the control loop from core1 to core0. The loop pushes one
+// timestamped record per period into a single producer, single consumer
+// ring, core0 takes them into the statistics of its display interval and
+// optionally streams them to USB in binary. Neither side takes a lock,
+// a full ring drops the new records so the loop never waits for core0.
+// SL (2025)
+//
+#include <stdio.h>
+#include <math.h>
+#include <hardware/sync.h>
+#include <pico/stdio_usb.h>
+#include "telemetry.h"
+
+// 100ms of records at the 10kHz loop rate
+#define RING_RECORDS 1024
+#define RING_MASK (RING_RECORDS - 1)
+
+#define STREAM_RECORD_BYTES 14
+#define STREAM_BATCH_RECORDS 32
+
+typedef struct
+{
+    int32_t min;
+    int32_t max;
+    uint64_t sum;
+    uint64_t sum_squares;
+} channel_sums_t;
+
+static telemetry_record_t s_ring[RING_RECORDS];
+static volatile uint32_t s_head = 0;    // written by the producer only
+static volatile uint32_t s_tail = 0;    // written by the consumer only
+static volatile uint32_t s_dropped = 0; // written by the producer only
+
+static uint32_t s_count;
+static uint32_t s_reported_dropped;
+static channel_sums_t s_current_sums;
+static channel_sums_t s_voltage_sums;
+static bool s_is_streaming = false;
+
+bool telemetry_push(const telemetry_record_t *record)
+{
+    uint32_t head = s_head;
+    if (head - s_tail == RING_RECORDS) {
+        s_dropped += 1;
+        return false;
+    }
+
+    s_ring[head & RING_MASK] = *record;
+
+    // the record is in memory before the consumer sees the new head
+    __dmb();
+    s_head = head + 1;
+    return true;
+}
+
+static void reset_sums(channel_sums_t *sums)
+{
+    sums->min = INT32_MAX;
+    sums->max = INT32_MIN;
+    sums->sum = 0;
+    sums->sum_squares = 0;
+}
+
+static void add_to_sums(channel_sums_t *sums, int32_t value)
+{
+    if (value < sums->min) sums->min = value;
+    if (value > sums->max) sums->max = value;
+    sums->sum += value;
+    sums->sum_squares += (uint64_t)((int64_t)value * value);
+}
+
+static void compute_stats(const channel_sums_t *sums, uint32_t count, telemetry_channel_stats_t *stats)
+{
+    stats->min = sums->min;
+    stats->max = sums->max;
+    stats->mean = (float)sums->sum / count;
+    stats->rms = sqrtf((float)sums->sum_squares / count);
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t value)
+{
+    return put16(put16(p, (uint16_t)value), (uint16_t)(value >> 16));
+}
+
+static uint8_t *encode_record(uint8_t *p, const telemetry_record_t *record)
+{
+    p = put16(p, TELEMETRY_SYNC_WORD);
+    p = put32(p, record->time_us);
+    p = put16(p, record->current_ma);
+    p = put16(p, record->voltage_mv);
+    p = put16(p, record->setpoint_ma);
+    return put16(p, record->dac_value);
+}
+
+static void write_batch(const uint8_t *batch, size_t size)
+{
+    if (size == 0) return;
+    fwrite(batch, 1, size, stdout);
+    fflush(stdout);
+}
+
+void telemetry_poll()
+{
+    if (s_count == 0) {
+        reset_sums(&s_current_sums);
+        reset_sums(&s_voltage_sums);
+    }
+
+    uint8_t batch[STREAM_BATCH_RECORDS * STREAM_RECORD_BYTES];
+    uint8_t *p = batch;
+
+    uint32_t head = s_head;
+    __dmb();
+    while (s_tail != head) {
+        telemetry_record_t record = s_ring[s_tail & RING_MASK];
+
+        // the slot is free for the producer once the record is copied
+        __dmb();
+        s_tail = s_tail + 1;
+
+        add_to_sums(&s_current_sums, record.current_ma);
+        add_to_sums(&s_voltage_sums, record.voltage_mv);
+        s_count += 1;
+
+        if (s_is_streaming) {
+            p = encode_record(p, &record);
+            if (p == batch + sizeof(batch)) {
+                write_batch(batch, sizeof(batch));
+                p = batch;
+            }
+        }
+    }
+
+    write_batch(batch, p - batch);
+}
+
+bool telemetry_take_stats(telemetry_stats_t *stats)
+{
+    telemetry_poll();
+
+    uint32_t dropped = s_dropped;
+    stats->count = s_count;
+    stats->dropped = dropped - s_reported_dropped;
+    s_reported_dropped = dropped;
+    if (s_count == 0) return false;
+
+    compute_stats(&s_current_sums, s_count, &stats->current_ma);
+    compute_stats(&s_voltage_sums, s_count, &stats->voltage_mv);
+    s_count = 0;
+    return true;
+}
+
+void telemetry_set_streaming(bool on)
+{
+    // binary records must not get CR added before their LF bytes
+    stdio_set_translate_crlf(&stdio_usb, !on);
+    s_is_streaming = on;
+}
+
+bool telemetry_is_streaming()
+{
+    return s_is_streaming;
+}
@@ -0,0 +1,53 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <pico/stdlib.h>
+
+// One control loop period, written by core1 and read by core0.
+typedef struct
+{
+    uint32_t time_us;
+    uint16_t current_ma;
+    uint16_t voltage_mv;
+    uint16_t setpoint_ma;
+    uint16_t dac_value;
+} telemetry_record_t;
+
+typedef struct
+{
+    int32_t min;
+    int32_t max;
+    float mean;
+    float rms;
+} telemetry_channel_stats_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t dropped;
+    telemetry_channel_stats_t current_ma;
+    telemetry_channel_stats_t voltage_mv;
+} telemetry_stats_t;
+
+// Binary stream: each record goes as the sync word and the record
+// fields, all little endian, 14 bytes per record.
+#define TELEMETRY_SYNC_WORD 0x5AA5
+
+/// @brief Adds the record to the ring, called by the producer core only.
+/// @return False if the ring is full and the record is dropped.
+bool telemetry_push(const telemetry_record_t *record);
+
+/// @brief Takes the records from the ring into the interval statistics
+/// and into the binary stream, called by the consumer core only.
+void telemetry_poll();
+
+/// @brief Returns the statistics of the interval and starts a new one.
+/// @return False if there were no records in the interval.
+bool telemetry_take_stats(telemetry_stats_t *stats);
+
+/// @brief Turns the binary stream of the records to USB on or off.
+void telemetry_set_streaming(bool on);
+bool telemetry_is_streaming();
+
+// _TELEMETRY_H_
+#endif
@@ -7,10 +7,11 @@
 #define STOP_COMMAND_NAME "STOP"
 #define SET_COMMAND_NAME "SET"
 #define RUN_COMMAND_NAME "RUN"
+#define SWEEP_COMMAND_NAME "SWEEP"
 
 static user_command_t _user_command;
 
-#define MAX_BUFFER 32
+#define MAX_BUFFER 48
 static char _buffer[MAX_BUFFER];
 static uint8_t _bufferSize = 0;
 
@@ -121,6 +122,20 @@ static bool ParseCommand(char *commandName, int commandId, int numParams)
             return false;
         if (numParams == 3)
             return true;
+
+        inside += length;
+        length = ParseNumberAfterSpaces(inside, &_user_command.parameter_4);
+        if (length < 1)
+            return false;
+        if (numParams == 4)
+            return true;
+
+        inside += length;
+        length = ParseNumberAfterSpaces(inside, &_user_command.parameter_5);
+        if (length < 1)
+            return false;
+        if (numParams == 5)
+            return true;
     }
 
     return false;
@@ -136,6 +151,10 @@ static bool ParseCommandInBuffer()
     if (ParseCommand(RUN_COMMAND_NAME, RUN_COMMAND_ID, 2))
         return true;
 
+    // parse SWEEP command with five parameters
+    if (ParseCommand(SWEEP_COMMAND_NAME, SWEEP_COMMAND_ID, 5))
+        return true;
+
     // parse PWM command with two parameters
     if (ParseCommand(PWM_COMMAND_NAME, PWM_COMMAND_ID, 2))
         return true;
@@ -171,6 +190,10 @@ void command_parse_input_char(char ch)
 
         _buffer[_bufferSize] = 0;
 
+        // the buffer is free before the command runs, a long command
+        // like SWEEP may pass its input back here
+        _bufferSize = 0;
+
         // analyze buffer
         if (ParseCommandInBuffer())
         {
@@ -180,8 +203,6 @@ void command_parse_input_char(char ch)
         {
             command_respond_syntax_error(_buffer);
         }
-
-        _bufferSize = 0;
         return;
     }
 
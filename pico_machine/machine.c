@@ -1,12 +1,22 @@
 
 #include "machine.h"
+#include "machine_sweep.h"
 
 #define PROGRAM_NAME "InductorMachine"
 
 // maximum number of samples we can deliver in one ADC batch
 #define MAX_SAMPLES 500
 
+// limits of the SWEEP command
+#define MAX_SWEEP_POINTS 1000
+#define MAX_SWEEP_DWELL_MS 10000
+#define MAX_SWEEP_MS 60000
+
 static uint8_t _capture_buffer[MAX_SAMPLES];
+static uint _pwm_hz = 0;
+static float _pwm_duty = 0;
+static uint _burst_on = 0;
+static uint _burst_off = 0;
 
 /// @brief Initializes all the machine functions.
 void mach_init()
@@ -30,7 +40,7 @@ static bool respond_pwm_success(char *what)
 {
     pwm_config_t config = mach_pwm_get_config();
     char buf[50];
-    sprintf(buf, "PWM %s (D=%d W=%d L=%d)", what, config.divider, config.wrap, config.level); 
+    sprintf(buf, "PWM %s (D=%d/16 W=%d L=%d)", what, config.divider, config.wrap, config.level); 
     return command_respond_success(buf);
 }
 
@@ -46,6 +56,8 @@ static bool execute_pwm_and_respond(uint hz, uint duty1024)
         return command_respond_user_error("duty cycle out of range [0,1023]", NULL);
 
     float duty = (float)(duty1024 * 100) / 1023;
+    _pwm_hz = hz;
+    _pwm_duty = duty;
 
     if(mach_pwm_is_running()) {
         mach_pwm_change_waveform(hz, duty);
@@ -99,6 +111,81 @@ static bool execute_adc_batch_and_respond(uint adc_channel)
   return command_respond_end(true);
 }
 
+//
+// Waits the dwell of a sweep point, any host input cuts it short.
+// Returns the input char or PICO_ERROR_TIMEOUT.
+//
+static int wait_sweep_dwell(uint dwell_ms)
+{
+    absolute_time_t until = make_timeout_time_ms(dwell_ms);
+    int64_t left_us = absolute_time_diff_us(get_absolute_time(), until);
+    return getchar_timeout_us(left_us > 0 ? (uint32_t)left_us : 0);
+}
+
+//
+// Executes the SWEEP user command. Steps the running PWM frequency from start to stop,
+// lets the tank settle for dwell milliseconds at each point, records an ADC period and
+// streams back one "hz,rms,peak" item per point, where rms is the AC RMS in tenths 
+// of ADC units and peak is the largest deviation from the mean. Any input from the 
+// host aborts the sweep, the response then ends with ABORTED and the input goes on 
+// to the command parser. The PWM frequency is restored at the end.
+//
+static bool execute_sweep_and_respond(uint start_hz, uint stop_hz, uint step_hz, 
+    uint dwell_ms, uint adc_channel)
+{
+    if (start_hz < 10 || stop_hz < 10)
+        return command_respond_user_error("hz < 10", NULL);
+
+    if (step_hz == 0)
+        return command_respond_user_error("step is zero", NULL);
+
+    uint num_points = mach_sweep_count_points(start_hz, stop_hz, step_hz);
+    if (num_points > MAX_SWEEP_POINTS)
+        return command_respond_user_error("too many points", NULL);
+
+    if (dwell_ms > MAX_SWEEP_DWELL_MS)
+        return command_respond_user_error("dwell out of range [0,10000]", NULL);
+
+    if ((uint64_t)num_points * dwell_ms > MAX_SWEEP_MS)
+        return command_respond_user_error("sweep is longer than 60 seconds", NULL);
+
+    if (adc_channel > 2)
+        return command_respond_user_error("ADC channel out of range [0,2]->[GPIO26,GPIO28]", NULL);
+
+    if (!mach_pwm_is_running())
+        return command_respond_user_error("Can't sweep when PWM isn't running", NULL);
+
+    int input = PICO_ERROR_TIMEOUT;
+    command_respond_success_begin();
+    for (uint i = 0; i < num_points; i++) {
+        uint hz = mach_sweep_point_hz(start_hz, stop_hz, step_hz, i);
+
+        // new waveform starts on a period boundary
+        mach_pwm_change_waveform(hz, _pwm_duty);
+        input = wait_sweep_dwell(dwell_ms);
+        if (input != PICO_ERROR_TIMEOUT) {
+            command_respond_data(i > 0 ? " ABORTED" : "ABORTED");
+            break;
+        }
+
+        uint num_samples = machAdcMeasurePeriod(adc_channel, _capture_buffer, sizeof(_capture_buffer));
+        mach_sweep_stats_t stats;
+        mach_sweep_compute_stats(_capture_buffer, num_samples, &stats);
+
+        char temp[40];
+        sprintf(temp, (i > 0) ? " %d,%d.%d,%d" : "%d,%d.%d,%d", 
+            hz, stats.rms10 / 10, stats.rms10 % 10, stats.peak);
+        command_respond_data(temp);
+    }
+
+    mach_pwm_change_waveform(_pwm_hz, _pwm_duty);
+    bool result = command_respond_end(true);
+
+    // the input which has aborted the sweep starts the next command
+    if (input != PICO_ERROR_TIMEOUT) command_parse_input_char((char)input);
+    return result;
+}
+
 //
 // Executes the STOP user command, stops everything running now.
 //
@@ -133,6 +220,60 @@ static bool execute_set_command_and_respond(char *name, int value)
         return respond_set_success(name, value); 
     }
 
+    if(strcasecmp(name, "phase_shift") == 0) {
+        if(value < 0 || value > 1) 
+            return command_respond_user_error("value not in [0,1]", name);
+        mach_pwm_set_phase_shift_mode((bool)value);    
+        return respond_set_success(name, value); 
+    }
+
+    // phase offset of the right leg in 1/10 degree
+    if(strcasecmp(name, "phase") == 0) {
+        if(value < 0 || value > 1800) 
+            return command_respond_user_error("value not in [0,1800]", name);
+        mach_pwm_set_phase(value);    
+        return respond_set_success(name, value); 
+    }
+
+    // burst mode is on when both period counts are above zero
+    if(strcasecmp(name, "burst_on") == 0) {
+        if(value < 0 || value > 10000) 
+            return command_respond_user_error("value not in [0,10000]", name);
+        _burst_on = value;
+        mach_pwm_set_burst(_burst_on, _burst_off);    
+        return respond_set_success(name, value); 
+    }
+
+    if(strcasecmp(name, "burst_off") == 0) {
+        if(value < 0 || value > 10000) 
+            return command_respond_user_error("value not in [0,10000]", name);
+        _burst_off = value;
+        mach_pwm_set_burst(_burst_on, _burst_off);    
+        return respond_set_success(name, value); 
+    }
+
+    if(strcasecmp(name, "pio_bridge") == 0) {
+        if(value < 0 || value > 1) 
+            return command_respond_user_error("value not in [0,1]", name);
+        mach_pwm_set_pio_bridge((bool)value);    
+        return respond_set_success(name, value); 
+    }
+
+    // bridge dead times are in system clocks
+    if(strcasecmp(name, "dead_rise") == 0) {
+        if(value < 0 || value > 1000) 
+            return command_respond_user_error("value not in [0,1000]", name);
+        mach_bridge_set_dead_rise(value);    
+        return respond_set_success(name, value); 
+    }
+
+    if(strcasecmp(name, "dead_fall") == 0) {
+        if(value < 0 || value > 1000) 
+            return command_respond_user_error("value not in [0,1000]", name);
+        mach_bridge_set_dead_fall(value);    
+        return respond_set_success(name, value); 
+    }
+
     if(strcasecmp(name, "max_waves") == 0) {
         if(value < 1 || value > 100) 
             return command_respond_user_error("value not in [1,100]", name);
@@ -140,6 +281,28 @@ static bool execute_set_command_and_respond(char *name, int value)
         return respond_set_success(name, value); 
     }     
 
+    if(strcasecmp(name, "track") == 0) {
+        if(value < 0 || value > 1) 
+            return command_respond_user_error("value not in [0,1]", name);
+        DirectSetTracking((bool)value);    
+        return respond_set_success(name, value); 
+    }
+
+    // tracking loop gains are in 1/256 steps
+    if(strcasecmp(name, "track_kp") == 0) {
+        if(value < 0 || value > 1024) 
+            return command_respond_user_error("value not in [0,1024]", name);
+        DirectSetTrackingKp(value);    
+        return respond_set_success(name, value); 
+    }
+
+    if(strcasecmp(name, "track_ki") == 0) {
+        if(value < 0 || value > 1024) 
+            return command_respond_user_error("value not in [0,1024]", name);
+        DirectSetTrackingKi(value);    
+        return respond_set_success(name, value); 
+    }
+
     return command_respond_user_error("unknown parameter", name);        
 }
 
@@ -156,6 +319,10 @@ bool mach_execute_command_and_respond(user_command_t *command_ptr)
         case RUN_COMMAND_ID:
             return execute_run_and_respond(command_ptr->parameter_1, command_ptr->parameter_2); 
 
+        case SWEEP_COMMAND_ID:
+            return execute_sweep_and_respond(command_ptr->parameter_1, command_ptr->parameter_2, 
+                command_ptr->parameter_3, command_ptr->parameter_4, command_ptr->parameter_5);
+
         case STOP_COMMAND_ID:
             return execute_stop_and_respond();
 
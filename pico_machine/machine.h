@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 #include "pico/stdlib.h"
+#include "pwm_reload.h"
 
 enum {
   HELLO_COMMAND_ID,
@@ -12,7 +13,8 @@ enum {
   ADC_COMMAND_ID,
   STOP_COMMAND_ID,
   SET_COMMAND_ID,
-  RUN_COMMAND_ID
+  RUN_COMMAND_ID,
+  SWEEP_COMMAND_ID
 };
 
 typedef struct  
@@ -21,16 +23,30 @@ typedef struct
   int parameter_1;
   int parameter_2;
   int parameter_3;
+  int parameter_4;
+  int parameter_5;
   char set_name[20];
 } user_command_t;
 
 typedef struct 
 {
-  uint divider;
+  uint divider; // in 1/16 steps
   uint wrap;
   uint level;
 } pwm_config_t;
 
+// Statistics of the captured zero-cross periods.
+typedef struct
+{
+  uint count;   // periods in the statistics
+  uint lost;    // periods overwritten before they were read
+  float mean_hz;
+  float mean_ns;
+  float min_ns;
+  float max_ns;
+  float jitter_ns; // standard deviation of the period
+} mach_sense_stats_t;
+
 // Machine core functions.
 void mach_init();
 bool mach_execute_command_and_respond(user_command_t *command);
@@ -44,12 +60,34 @@ pwm_config_t mach_pwm_get_config();
 void mach_pwm_stop();
 void mach_pwm_set_dead_clocks(uint dead_clocks);
 void mach_pwm_set_one_sided(bool one_sided);
+void mach_pwm_set_pio_bridge(bool use_pio_bridge);
+void mach_pwm_set_phase_shift_mode(bool phase_shift_mode);
+void mach_pwm_set_phase(uint decidegrees);
+void mach_pwm_set_burst(uint on_periods, uint off_periods);
+pwm_reload_t *mach_pwm_get_reload(uint slice_num);
+
+// PIO bridge functions.
+void mach_bridge_init();
+void mach_bridge_start(uint hz, float duty, void (*period_handler)());
+void mach_bridge_change_waveform(uint hz, float duty);
+bool mach_bridge_is_running();
+pwm_config_t mach_bridge_get_config();
+void mach_bridge_stop();
+void mach_bridge_set_dead_rise(uint clocks);
+void mach_bridge_set_dead_fall(uint clocks);
 
 // ADC functions.
 void machAdcInit();
 uint machAdcMeasurePeriod(uint channel_num, uint8_t *buffer, uint buffer_size);
 void machAdcHandlePeriodEnd(); 
 
+// Zero-cross capture functions.
+void mach_sense_init(uint gpio);
+void mach_sense_start();
+void mach_sense_stop();
+uint mach_sense_read_periods(uint64_t *sum_clocks);
+bool mach_sense_get_stats(mach_sense_stats_t *stats);
+
 // User command format functions.
 void command_parse_input_char(char ch);
 void command_respond_success_begin();
@@ -61,11 +99,14 @@ bool command_respond_user_error(char *message, char *param);
 
 // PWM helpers.
 uint16_t compute_pwm_match_level(uint16_t top, float duty, bool inverted);
-uint16_t compute_pwm_top_and_divider(uint hz, bool dual_slope, uint *divider_ptr);
 
 // Direct drive functions.
 void DirectInit();
 void DirectSetMaxWaves(uint waves);
+void DirectSetTracking(bool enable);
+void DirectSetTrackingKp(int kp);
+void DirectSetTrackingKi(int ki);
+bool DirectIsLocked();
 bool DirectRunAndRespond(int hertz, float duty);
 void DirectStop();
 bool DirectStopAndRespond();
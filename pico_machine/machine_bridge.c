@@ -0,0 +1,332 @@
+//
+// Full-bridge gate generator on PIO. One PWM period is a pattern of 8
+// steps: four plateaus of the gate states and four dead steps, one per
+// leg transition, where the switching leg has both gates off. The step
+// lengths are in system clocks, so the rise and fall dead times are
+// exact at any frequency, unlike the dead time of the PWM slices which
+// is counted in the divided clock.
+//
+// The pattern is fed to the TX FIFO by a data DMA channel, a control
+// channel then restarts it from the active pattern pointer, so a new
+// waveform is taken at the period boundary and the CPU is not involved.
+//
+
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/clocks.h>
+#include "machine.h"
+#include "bridge.pio.h"
+
+#define PATTERN_STEPS 8
+#define PATTERN_EDGES 4
+#define GPIO_FIRST_GATE 0 // GP0-GP3 are left high, left low, right high, right low
+
+// gate bits of the pattern steps
+#define LEFT_HIGH_BIT (1 << 0)
+#define LEFT_LOW_BIT (1 << 1)
+#define RIGHT_HIGH_BIT (1 << 2)
+#define RIGHT_LOW_BIT (1 << 3)
+#define LEFT_LEG_BITS (LEFT_HIGH_BIT | LEFT_LOW_BIT)
+#define RIGHT_LEG_BITS (RIGHT_HIGH_BIT | RIGHT_LOW_BIT)
+
+#define PERIOD_START_BIT (1 << 4)
+#define STEP_LENGTH_LSB 5
+
+typedef struct
+{
+    uint32_t time;  // clocks from the period start
+    uint leg_bits;  // gates of the switching leg
+    bool rise;      // high side goes on
+} bridge_edge_t;
+
+static uint32_t _patterns[2][PATTERN_STEPS];
+static uint32_t *volatile _active_pattern = _patterns[0];
+
+static const PIO _pio = pio1;
+static uint _sm;
+static uint _offset;
+static uint _data_channel;
+static uint _control_channel;
+
+static uint _dead_rise_clocks = 0;
+static uint _dead_fall_clocks = 0;
+static bool _is_running = false;
+static uint32_t _period_clocks;
+static uint32_t _high_clocks;
+static void (*_user_period_handler)();
+
+/// @brief Loads the bridge program and claims the DMA channels.
+void mach_bridge_init()
+{
+    _sm = pio_claim_unused_sm(_pio, true);
+    _offset = pio_add_program(_pio, &bridge_program);
+    _data_channel = dma_claim_unused_channel(true);
+    _control_channel = dma_claim_unused_channel(true);
+}
+
+/// @brief Sets the clocks between a low side going off and the high side going on.
+void mach_bridge_set_dead_rise(uint clocks)
+{
+    _dead_rise_clocks = clocks;
+}
+
+/// @brief Sets the clocks between a high side going off and the low side going on.
+void mach_bridge_set_dead_fall(uint clocks)
+{
+    _dead_fall_clocks = clocks;
+}
+
+static inline uint compute_gates(const uint32_t *edge_times, uint32_t t)
+{
+    // edge times are left fall, left rise, right rise, right fall
+    bool left_high = t < edge_times[0] || t >= edge_times[1];
+    bool right_high = t >= edge_times[2] && t < edge_times[3];
+    return (left_high ? LEFT_HIGH_BIT : LEFT_LOW_BIT) |
+        (right_high ? RIGHT_HIGH_BIT : RIGHT_LOW_BIT);
+}
+
+static inline int32_t step_overhead(bool period_start)
+{
+    return BRIDGE_STEP_CLOCKS + (period_start ? 1 : 0);
+}
+
+static uint32_t make_step(uint gates, int32_t clocks, bool period_start)
+{
+    int32_t overhead = step_overhead(period_start);
+    uint32_t length = clocks > overhead ? clocks - overhead : 0;
+    return (length << STEP_LENGTH_LSB) | (period_start ? PERIOD_START_BIT : 0) | gates;
+}
+
+//
+// Shortest time between two switching points: the dead step, which
+// lasts at least the step overhead, and a plateau step of the overhead.
+// Edges of different legs closer than this switch together, edges of one
+// leg are kept this far apart by the duty limits.
+//
+static int32_t min_switch_gap()
+{
+    int32_t dead = MAX(_dead_rise_clocks, _dead_fall_clocks);
+    return MAX(dead, step_overhead(true)) + BRIDGE_STEP_CLOCKS;
+}
+
+//
+// Builds the pattern of the PWM slices waveform: each leg is high for
+// the same time per period, the left leg around the period start and the
+// right leg around its middle, so the bridge polarity changes twice.
+// Near 50% duty the edges of the two legs come close together, those are
+// merged into one switching point with the longer dead time. The pattern
+// always has 8 steps, the longest plateaus are split to fill it.
+//
+static void fill_pattern(uint32_t *pattern, uint32_t period, uint32_t high)
+{
+    bridge_edge_t edges[PATTERN_EDGES] = {
+        { high / 2, LEFT_LEG_BITS, false },
+        { period - high / 2, LEFT_LEG_BITS, true },
+        { period / 2 - high / 2, RIGHT_LEG_BITS, true },
+        { period / 2 + high / 2, RIGHT_LEG_BITS, false },
+    };
+
+    // order the edges in time
+    for (int i = 1; i < PATTERN_EDGES; i++) {
+        for (int j = i; j > 0 && edges[j].time < edges[j - 1].time; j--) {
+            bridge_edge_t temp = edges[j];
+            edges[j] = edges[j - 1];
+            edges[j - 1] = temp;
+        }
+    }
+
+    // switching points, an edge close to the previous one joins it
+    int32_t min_gap = min_switch_gap();
+    bridge_edge_t points[PATTERN_EDGES];
+    int32_t point_dead[PATTERN_EDGES];
+    int num_points = 0;
+    for (int i = 0; i < PATTERN_EDGES; i++) {
+        int32_t dead = edges[i].rise ? _dead_rise_clocks : _dead_fall_clocks;
+        if (num_points > 0 && (points[num_points - 1].leg_bits & edges[i].leg_bits) == 0 &&
+            (int32_t)(edges[i].time - points[num_points - 1].time) < min_gap) {
+            points[num_points - 1].leg_bits |= edges[i].leg_bits;
+            point_dead[num_points - 1] = MAX(point_dead[num_points - 1], dead);
+            edges[i].time = points[num_points - 1].time;
+            continue;
+        }
+        points[num_points] = edges[i];
+        point_dead[num_points] = dead;
+        num_points += 1;
+    }
+
+    // edge times are in the compute_gates() order
+    uint32_t edge_times[PATTERN_EDGES];
+    for (int i = 0; i < PATTERN_EDGES; i++) {
+        bool left = edges[i].leg_bits == LEFT_LEG_BITS;
+        edge_times[left ? (edges[i].rise ? 1 : 0) : (edges[i].rise ? 2 : 3)] = edges[i].time;
+    }
+
+    uint step_gates[PATTERN_STEPS];
+    int32_t step_clocks[PATTERN_STEPS];
+    bool step_is_plateau[PATTERN_STEPS];
+    int num_steps = 0;
+    for (int i = 0; i < num_points; i++) {
+        bridge_edge_t *point = &points[i];
+        uint32_t next_time = (i + 1 < num_points) ?
+            points[i + 1].time : points[0].time + period;
+
+        // the switching legs have both gates off for the dead time first,
+        // a dead step shorter than the overhead takes it from the plateau
+        uint gates = compute_gates(edge_times, point->time);
+        int32_t dead = MAX(point_dead[i], step_overhead(i == 0));
+        step_gates[num_steps] = gates & ~point->leg_bits;
+        step_clocks[num_steps] = dead;
+        step_is_plateau[num_steps++] = false;
+        step_gates[num_steps] = gates;
+        step_clocks[num_steps] = (int32_t)(next_time - point->time) - dead;
+        step_is_plateau[num_steps++] = true;
+    }
+
+    // split the longest plateau until the pattern is full
+    while (num_steps < PATTERN_STEPS) {
+        int longest = 1;
+        for (int i = 1; i < num_steps; i++) {
+            if (step_is_plateau[i] && step_clocks[i] > step_clocks[longest]) longest = i;
+        }
+        for (int i = num_steps; i > longest + 1; i--) {
+            step_gates[i] = step_gates[i - 1];
+            step_clocks[i] = step_clocks[i - 1];
+            step_is_plateau[i] = step_is_plateau[i - 1];
+        }
+        step_gates[longest + 1] = step_gates[longest];
+        step_is_plateau[longest + 1] = true;
+        step_clocks[longest + 1] = step_clocks[longest] / 2;
+        step_clocks[longest] -= step_clocks[longest + 1];
+        num_steps += 1;
+    }
+
+    for (int i = 0; i < PATTERN_STEPS; i++) {
+        pattern[i] = make_step(step_gates[i], step_clocks[i], i == 0);
+    }
+}
+
+static void on_period_irq()
+{
+    pio_interrupt_clear(_pio, 0);
+    if (_user_period_handler != NULL) _user_period_handler();
+}
+
+//
+// The period is at least one switching gap per step and the high time
+// of the legs is more than one gap from 0 and from the period, the one
+// more clock is lost by halving it, so duty 0 and 100 give the narrowest
+// pulses the dead times allow.
+//
+static void compute_waveform(uint hz, float duty)
+{
+    // same duty meaning as the PWM slices have, see compute_pwm_match_level()
+    uint32_t min_gap = min_switch_gap();
+    _period_clocks = MAX(clock_get_hz(clk_sys) / MAX(hz, 1u), PATTERN_STEPS * min_gap);
+    _high_clocks = (uint32_t)(_period_clocks * (100 - duty) / 100);
+    _high_clocks = MIN(MAX(_high_clocks, min_gap + 1), _period_clocks - min_gap - 1);
+}
+
+/// @brief Starts the gate signals on the bridge outputs.
+/// @param hz Frequency of PWM in cycles per second.
+/// @param duty Duty cycle in 100%.
+/// @param period_handler Callback handler to be called once per period.
+void mach_bridge_start(uint hz, float duty, void (*period_handler)())
+{
+    if (_is_running) mach_bridge_stop();
+
+    compute_waveform(hz, duty);
+    _active_pattern = _patterns[0];
+    fill_pattern(_active_pattern, _period_clocks, _high_clocks);
+
+    bridge_program_init(_pio, _sm, _offset, GPIO_FIRST_GATE);
+
+    // data channel feeds one pattern to the FIFO and chains to control
+    dma_channel_config cfg = dma_channel_get_default_config(_data_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, true);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_dreq(&cfg, pio_get_dreq(_pio, _sm, true));
+    channel_config_set_chain_to(&cfg, _control_channel);
+    dma_channel_configure(_data_channel, &cfg, &_pio->txf[_sm], _active_pattern,
+        PATTERN_STEPS, false);
+
+    // control channel restarts the data channel from the active pattern
+    cfg = dma_channel_get_default_config(_control_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, false);
+    dma_channel_configure(_control_channel, &cfg,
+        &dma_hw->ch[_data_channel].al3_read_addr_trig, &_active_pattern, 1, false);
+
+    _user_period_handler = period_handler;
+    pio_interrupt_clear(_pio, 0);
+    pio_set_irq0_source_enabled(_pio, pis_interrupt0, true);
+    irq_set_exclusive_handler(PIO1_IRQ_0, on_period_irq);
+    irq_set_enabled(PIO1_IRQ_0, true);
+
+    dma_channel_start(_data_channel);
+    pio_sm_set_enabled(_pio, _sm, true);
+    _is_running = true;
+}
+
+static bool is_pattern_read(const uint32_t *pattern)
+{
+    uintptr_t read_addr = dma_channel_hw_addr(_data_channel)->read_addr;
+    return read_addr >= (uintptr_t)pattern &&
+        read_addr <= (uintptr_t)(pattern + PATTERN_STEPS);
+}
+
+/// @brief With running bridge change the frequency and the duty cycle.
+/// @param hz New frequency
+/// @param duty New duty cycle
+void mach_bridge_change_waveform(uint hz, float duty)
+{
+    if (!_is_running) return;
+
+    // the other pattern is free once DMA has moved on to the active one,
+    // which takes at most one period
+    uint32_t *next = (_active_pattern == _patterns[0]) ? _patterns[1] : _patterns[0];
+    while (!is_pattern_read(_active_pattern)) tight_loop_contents();
+
+    compute_waveform(hz, duty);
+    fill_pattern(next, _period_clocks, _high_clocks);
+    _active_pattern = next;
+}
+
+/// @brief Returns true if the bridge is running now.
+bool mach_bridge_is_running()
+{
+    return _is_running;
+}
+
+/// @brief Returns the waveform in system clocks, the divider is always 1.
+pwm_config_t mach_bridge_get_config()
+{
+    pwm_config_t config;
+    config.divider = 16;
+    config.wrap = _period_clocks - 1;
+    config.level = _high_clocks;
+    return config;
+}
+
+/// @brief Stops the gate signals, the caller brings the outputs low.
+void mach_bridge_stop()
+{
+    if (_is_running) {
+        pio_sm_set_enabled(_pio, _sm, false);
+
+        // break the chain before aborting, so control can't restart data
+        dma_channel_config cfg = dma_get_channel_config(_data_channel);
+        channel_config_set_chain_to(&cfg, _data_channel);
+        dma_channel_set_config(_data_channel, &cfg, false);
+        dma_channel_abort(_control_channel);
+        dma_channel_abort(_data_channel);
+
+        pio_sm_set_pins_with_mask(_pio, _sm, 0, 0xf << GPIO_FIRST_GATE);
+        pio_set_irq0_source_enabled(_pio, pis_interrupt0, false);
+        irq_set_enabled(PIO1_IRQ_0, false);
+        _user_period_handler = NULL;
+        _is_running = false;
+    }
+}
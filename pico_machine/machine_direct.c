@@ -1,11 +1,20 @@
 //
 // DirectDrive inductor mode functions. 
 //
+// In tracking mode the drive frequency follows the LC-tank resonance:
+// the tank periods are captured by the zero_cross PIO program and a PI
+// loop moves PWM top so that the drive period stays equal to max_waves
+// tank periods while the resonance drifts with temperature and load.
+//
 
 #include <time.h>
 #include <hardware/gpio.h>
 #include <hardware/pwm.h>
+#include <hardware/clocks.h>
 #include "machine.h"
+#include "pwm_timing.h"
+#include "pwm_reload.h"
+#include "machine_track.h"
 
 const uint gpioDrive = 1; // GPIO1 drives power mosfets
 const uint gpioSense = 4; // GPIO4 senses current zero-crossing signal
@@ -15,15 +24,25 @@ static uint runningSliceNum;
 static uint maxWavesParameter = 2;
 static uint waveCount = 0;
 
-static bool isMeasuring = false;
-static uint measureCount = 0;
-#define MAX_MEASURES 10
-static uint64_t measures[MAX_MEASURES];
+static pwm_timing_t runningTiming;
+static float runningDuty;
+
+#define TRACK_INTERVAL_US 1000
+
+// tracking loop gains are Q8 fixed point, 256 is the gain of 1
+static bool isTrackingEnabled = false;
+static mach_track_t track = { .kp = 64, .ki = 8 };
+
+static pwm_reload_t *trackReload;
+static repeating_timer_t trackTimer;
+static bool isTracking = false;
 
 static void senseCallbackRoutine(uint gpio, uint32_t events);
 static void enableSenseCallback(bool enable);
 static void startPwm(int hertz, float duty);
-static uint computeMeasuredWaveHz();
+static void startTracking();
+static void stopTracking();
+static bool trackTimerCallback(repeating_timer_t *timer);
 
 void DirectInit()
 {
@@ -32,6 +51,10 @@ void DirectInit()
     gpio_set_pulls(gpioDrive, false, true); // pull-down
     gpio_set_dir(gpioDrive, GPIO_OUT); // output direction
     gpio_put(gpioDrive, false); // low initial state
+
+    mach_sense_init(gpioSense);
+    // drive slice is one of the bridge slices, their engine is shared
+    trackReload = mach_pwm_get_reload(pwm_gpio_to_slice_num(gpioDrive));
 }
 
 void DirectSetMaxWaves(uint maxWaves)
@@ -39,6 +62,26 @@ void DirectSetMaxWaves(uint maxWaves)
     maxWavesParameter = maxWaves;
 }
 
+void DirectSetTracking(bool enable)
+{
+    isTrackingEnabled = enable;
+}
+
+void DirectSetTrackingKp(int kp)
+{
+    track.kp = kp;
+}
+
+void DirectSetTrackingKi(int ki)
+{
+    track.ki = ki;
+}
+
+bool DirectIsLocked()
+{
+    return isTracking && mach_track_is_locked(&track);
+}
+
 bool DirectRunAndRespond(int hertz, float duty)
 {
     if(isRunning) DirectStop();  
@@ -46,12 +89,11 @@ bool DirectRunAndRespond(int hertz, float duty)
     waveCount = 0;
     isRunning = true;
 
-    isMeasuring = true;
-    measureCount = 0;
-
     led_set(true);
     startPwm(hertz, duty); 
     enableSenseCallback(true); 
+    mach_sense_start();
+    if (isTrackingEnabled) startTracking();
 
     return command_respond_success("DirectDrive started");
 }
@@ -66,8 +108,10 @@ void DirectStop()
     if (isRunning) {
         isRunning = false;
         led_set(false);
+        if (isTracking) stopTracking();
         pwm_set_enabled(runningSliceNum, false);
         enableSenseCallback(false);
+        mach_sense_stop();
     }
 }
 
@@ -75,8 +119,20 @@ bool DirectStopAndRespond()
 {
     DirectStop();
 
-    char buf[50];
-    sprintf(buf, "Stopped (measured wave %d Hz)", computeMeasuredWaveHz());
+    mach_sense_stats_t stats;
+    if (!mach_sense_get_stats(&stats)) 
+        return command_respond_success("Stopped (no waves measured)");
+
+    char buf[160];
+    int n = sprintf(buf, "Stopped (measured wave %d Hz, period %.0f ns"
+        " min %.0f max %.0f jitter %.1f ns, %d waves, %d lost", 
+        (int)stats.mean_hz, stats.mean_ns, stats.min_ns, stats.max_ns,
+        stats.jitter_ns, stats.count, stats.lost);
+    if (isTrackingEnabled) {
+        n += sprintf(buf + n, ", tracked drive %d Hz, %s", (int)runningTiming.hz,
+            mach_track_is_locked(&track) ? "locked" : "unlocked");
+    }
+    sprintf(buf + n, ")");
     return command_respond_success(buf);
 }
 
@@ -88,14 +144,13 @@ static void startPwm(int hertz, float duty)
     // Find out which PWM slice is connected to driving GPIO
     runningSliceNum = pwm_gpio_to_slice_num(gpioDrive);
 
-    uint divider;
-    uint16_t top = compute_pwm_top_and_divider(hertz, false, &divider);
-    uint16_t match = compute_pwm_match_level(top, duty, false);  
+    pwm_timing_solve(hertz, false, &runningTiming);
+    runningDuty = duty;
+    uint16_t match = compute_pwm_match_level(runningTiming.top, duty, false);  
 
     // Load parameters into slice but not run
     pwm_config config = pwm_get_default_config();
-    pwm_config_set_wrap(&config, top);
-    pwm_config_set_clkdiv_int(&config, divider);
+    pwm_timing_apply(&config, &runningTiming);
     pwm_init(runningSliceNum, &config, false); 
 
     // Set PWM compare values for both A/B channels 
@@ -109,15 +164,11 @@ static void senseCallbackRoutine(uint gpio, uint32_t events)
 {
     waveCount += 1;
     if (waveCount >= maxWavesParameter) {
-       pwm_set_counter(runningSliceNum, 0);
+       // the tracking loop keeps the period itself, so the counter runs free
+       if (!isTracking) pwm_set_counter(runningSliceNum, 0);
        waveCount = 0;
        mach_adc_handle_period_end();
     }
-
-    if (isMeasuring) {
-        measures[measureCount] = time_us_64();
-        if (++measureCount == MAX_MEASURES) isMeasuring = false;
-    }
 } 
 
 static void enableSenseCallback(bool enable)
@@ -128,15 +179,42 @@ static void enableSenseCallback(bool enable)
     gpio_set_irq_enabled_with_callback(gpioSense, flags, enable, &senseCallbackRoutine);
 }
 
-static uint computeMeasuredWaveHz()
+static void startTracking()
+{
+    mach_track_reset(&track, runningTiming.top);
+
+    isTracking = true;
+    add_repeating_timer_us(-TRACK_INTERVAL_US, trackTimerCallback, NULL, &trackTimer);
+}
+
+static void stopTracking()
+{
+    cancel_repeating_timer(&trackTimer);
+    pwm_reload_cancel(trackReload);
+    isTracking = false;
+}
+
+//
+// One step of the tracking loop, see mach_track_step(). The new top is
+// written by DMA at the period boundary so no period is malformed.
+//
+static bool trackTimerCallback(repeating_timer_t *timer)
 {
-    if (measureCount <= 1) return 0;
-    
-    uint maxUs = 0;
-    for (int i = 1; i < measureCount; i++) {
-        uint us = (uint)(measures[i] - measures[i - 1]);
-        if (us > maxUs) maxUs = us;
+    uint64_t sumClocks;
+    uint periods = mach_sense_read_periods(&sumClocks);
+    if (periods == 0) return true; // tank is not oscillating
+
+    int32_t top = mach_track_step(&track, sumClocks, periods, maxWavesParameter,
+        runningTiming.div16, runningTiming.top);
+
+    // skip the step while the previous top is still on its way
+    if (top != runningTiming.top && !pwm_reload_is_pending(trackReload)) {
+        runningTiming.top = (uint16_t)top;
+        runningTiming.hz = (float)clock_get_hz(clk_sys) * 16 / 
+            ((float)(top + 1) * runningTiming.div16);
+        uint16_t match = compute_pwm_match_level(runningTiming.top, runningDuty, false);
+        pwm_reload_start(trackReload, &runningTiming, match, match);
     }
 
-    return maxUs > 0 ? 1000000 / maxUs : 0;
+    return true;
 }
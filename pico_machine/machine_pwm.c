@@ -3,11 +3,17 @@
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
 #include "hardware/gpio.h"
+#include "pwm_timing.h"
+#include "pwm_reload.h"
 
 static void bring_all_outputs_low();
+static void apply_phase_offset(uint16_t top);
 
 static uint _dead_clocks = 0;
 static bool _one_sided = false;
+static bool _use_pio_bridge = false;
+static bool _phase_shift_mode = false;
+static uint _phase_decidegrees = 0;
 
 const uint GPIO_LEFT_HIGH = 0;  // GP0  
 const uint GPIO_LEFT_LOW = 1;   // GP1
@@ -16,20 +22,58 @@ const uint GPIO_RIGHT_LOW = 3;  // GP3
 const bool USE_DUAL_SLOPE = true;
 
 static bool _slices_are_running = false;
+static bool _bridge_is_running = false;
+static bool _slices_are_phase_shifted = false;
+static uint _applied_phase_counts = 0;
 static uint _left_slice;
 static uint _right_slice;
 
-static volatile bool _reloading_wrap_level = false;
+static pwm_reload_t _left_reload;
+static pwm_reload_t _right_reload;
 static uint _selected_divider = 0;
 static uint16_t _selected_wrap = 0;
 static uint _selected_level = 0;
 
+// Compare levels of channel A and B of a slice.
+typedef struct {
+    uint16_t a;
+    uint16_t b;
+} slice_levels_t;
+
+static slice_levels_t _left_levels;
+static slice_levels_t _right_levels;
+
+// Waveform change of the phase shifted slices, armed by the wrap handler.
+static volatile bool _reload_at_wrap = false;
+static pwm_timing_t _pending_timing;
+static uint16_t _pending_match;
+
+// Burst mode: ON periods of the waveform, then OFF idle periods with
+// all outputs low while the counters keep running, repeating.
+static uint _burst_on_periods = 0;
+static uint _burst_off_periods = 0;
+static uint _burst_period_index = 0;
+
 static void (*_user_wrap_handler)();
 
 /// @brief Initialize the PWM module, bring all outputs low.
 void mach_pwm_init()
 {
     bring_all_outputs_low();
+
+    // waveform changes are written by DMA at the period boundary
+    pwm_reload_init(&_left_reload, pwm_gpio_to_slice_num(GPIO_LEFT_HIGH));
+    pwm_reload_init(&_right_reload, pwm_gpio_to_slice_num(GPIO_RIGHT_HIGH));
+
+    mach_bridge_init();
+}
+
+/// @brief Returns the waveform update engine of the slice, it's shared with the direct drive.
+pwm_reload_t *mach_pwm_get_reload(uint slice_num)
+{
+    if(slice_num == _left_reload.slice_num) return &_left_reload;
+    if(slice_num == _right_reload.slice_num) return &_right_reload;
+    return NULL;
 }
 
 /// @brief Set the number of MCU dead cycles between HIGH side going low and LOW side going high.
@@ -44,9 +88,41 @@ void mach_pwm_set_one_sided(bool one_sided)
     _one_sided = one_sided;
 }
 
+/// @brief Generate the gate signals by PIO instead of the PWM slices from the next start.
+void mach_pwm_set_pio_bridge(bool use_pio_bridge)
+{
+    _use_pio_bridge = use_pio_bridge;
+}
+
+/// @brief Run both legs at 50% and control the power by their phase offset from the next start.
+void mach_pwm_set_phase_shift_mode(bool phase_shift_mode)
+{
+    _phase_shift_mode = phase_shift_mode;
+}
+
+/// @brief Set the phase offset of the right leg in 1/10 degree, [0,1800].
+void mach_pwm_set_phase(uint decidegrees)
+{
+    _phase_decidegrees = decidegrees;
+    if(_slices_are_running && _slices_are_phase_shifted) {
+        apply_phase_offset(_selected_wrap);
+    }
+}
+
+/// @brief Set the burst mode periods, zero in any of them turns the burst mode off.
+/// @param on_periods Number of waveform periods in a burst.
+/// @param off_periods Number of idle periods after each burst.
+void mach_pwm_set_burst(uint on_periods, uint off_periods)
+{
+    _burst_on_periods = on_periods;
+    _burst_off_periods = off_periods;
+}
+
 /// @brief Returns the last used PWM configuration values.
 pwm_config_t mach_pwm_get_config()
 {
+    if(_bridge_is_running) return mach_bridge_get_config();
+
     pwm_config_t config;
     config.divider = _selected_divider;
     config.wrap = _selected_wrap;
@@ -59,13 +135,14 @@ static inline uint32_t make_both_slices_bitmask()
     return (1 << _left_slice) | (1 << _right_slice);
 }
 
-static void set_slice_match_levels(uint slice_num, uint16_t top, uint16_t match)
+static void compute_slice_match_levels(uint slice_num, uint16_t top, uint16_t match,
+    uint16_t *match_a_ptr, uint16_t *match_b_ptr)
 {
     // adjust the HIGH output channel A for the dead cycles,
     // left slice is "not shifted" and it's HIGH channel A match gets the minus DT cycles,
     // right slice is "shifted" and it's HIGH channel A match gets the plus DT cycles
     uint16_t match_a;
-    if(slice_num == _right_slice) {
+    if(slice_num == _right_slice && !_slices_are_phase_shifted) {
         uint16_t inverted_match = top - match;  
         uint16_t adjusted_match = (inverted_match + _dead_clocks);
         match_a = (adjusted_match <= top) ? adjusted_match : top;
@@ -74,12 +151,91 @@ static void set_slice_match_levels(uint slice_num, uint16_t top, uint16_t match)
         match_a = (_dead_clocks < match) ? (match - _dead_clocks) : 0;
     }
 
+    *match_a_ptr = match_a;
+    *match_b_ptr = match;
+}
+
+static slice_levels_t *get_slice_levels(uint slice_num)
+{
+    return (slice_num == _left_reload.slice_num) ? &_left_levels : &_right_levels;
+}
+
+// Levels which keep both outputs of the slice low, a channel with
+// inverted polarity is low while the counter is below its level.
+static slice_levels_t compute_off_levels(bool inverted_a)
+{
+    slice_levels_t levels;
+    levels.a = inverted_a ? 0xffff : 0;
+    levels.b = inverted_a ? 0 : 0xffff;
+    return levels;
+}
+
+static inline bool is_burst_enabled()
+{
+    return _burst_on_periods > 0 && _burst_off_periods > 0;
+}
+
+// Levels of both slices for the period with the index in the burst cycle.
+static void get_burst_levels(uint period_index, slice_levels_t *left, slice_levels_t *right)
+{
+    uint cycle = _burst_on_periods + _burst_off_periods;
+    if(!is_burst_enabled() || (period_index % cycle) < _burst_on_periods) {
+        *left = _left_levels;
+        *right = _right_levels;
+    } else {
+        *left = compute_off_levels(false);
+        *right = compute_off_levels(!_slices_are_phase_shifted);
+    }
+}
+
+static void set_burst_levels(uint period_index)
+{
+    slice_levels_t left, right;
+    get_burst_levels(period_index, &left, &right);
+    pwm_set_both_levels(_left_slice, left.a, left.b);
+    pwm_set_both_levels(_right_slice, right.a, right.b);
+}
+
+static void set_slice_match_levels(uint slice_num, uint16_t top, uint16_t match)
+{
+    slice_levels_t *levels = get_slice_levels(slice_num);
+    compute_slice_match_levels(slice_num, top, match, &levels->a, &levels->b);
+
     // set PWM compare values for both A/B channels 
-    pwm_set_both_levels(slice_num, match_a, match);
+    pwm_set_both_levels(slice_num, levels->a, levels->b);
+}
+
+static void reload_slice(pwm_reload_t *reload, const pwm_timing_t *timing, uint16_t match)
+{
+    slice_levels_t *levels = get_slice_levels(reload->slice_num);
+    compute_slice_match_levels(reload->slice_num, timing->top, match, &levels->a, &levels->b);
+
+    // the update lands at the second wrap from now, in burst mode
+    // that period may be an idle one
+    slice_levels_t left, right;
+    get_burst_levels(_burst_period_index + 2, &left, &right);
+    slice_levels_t *landing = (levels == &_left_levels) ? &left : &right;
+    pwm_reload_stage(reload, timing, landing->a, landing->b);
+}
+
+// Both engines are armed at once, two starts could have a wrap between
+// them and leave one leg a period behind the other for good.
+static void reload_both_slices(const pwm_timing_t *timing, uint16_t match)
+{
+    reload_slice(&_left_reload, timing, match);
+    reload_slice(&_right_reload, timing, match);
+    pwm_reload_arm_pair(&_left_reload, &_right_reload);
+}
+
+static void take_pending_reload()
+{
+    if(!_reload_at_wrap) return;
+    reload_both_slices(&_pending_timing, _pending_match);
+    _reload_at_wrap = false;
 }
 
 static uint configure_pwm_slice(
-    uint gpio_high, uint gpio_low, uint16_t top, uint16_t match, uint divider, bool phase_shifted)
+    uint gpio_high, uint gpio_low, const pwm_timing_t *timing, uint16_t match, bool phase_shifted)
 {
     // figure out which slice we just connected to the pin
     uint slice_num = pwm_gpio_to_slice_num(gpio_high);
@@ -95,9 +251,7 @@ static uint configure_pwm_slice(
     gpio_set_function(gpio_low, GPIO_FUNC_PWM);
 
     pwm_config config = pwm_get_default_config();
-    pwm_config_set_phase_correct(&config, USE_DUAL_SLOPE);
-    pwm_config_set_wrap(&config, top);
-    pwm_config_set_clkdiv_int(&config, divider);
+    pwm_timing_apply(&config, timing);
 
     // channel A and channel B are inverted again each other
     bool inverted = phase_shifted;
@@ -107,11 +261,36 @@ static uint configure_pwm_slice(
     pwm_init(slice_num, &config, false); 
 
     // set PWM compare values for both A/B channels 
-    set_slice_match_levels(slice_num, top, match);
+    set_slice_match_levels(slice_num, timing->top, match);
 
     return slice_num; 
 }
 
+// Offset of the right counter for the phase, a dual slope period is
+// 2*(top+1) counts and the offset is preloaded into the up counting half.
+static uint compute_phase_counts(uint16_t top)
+{
+    uint counts = (uint)(((uint64_t)top + 1) * _phase_decidegrees / 1800);
+    return counts <= top ? counts : top;
+}
+
+//
+// Moves the right leg to the new phase offset while both slices run. The
+// counters are only retarded, one count per divided clock, so every edge
+// moves by one count at most and no pulse is malformed. PH_ADV would need
+// the divider above 1, so a positive change retards the left slice instead.
+//
+static void apply_phase_offset(uint16_t top)
+{
+    uint counts = compute_phase_counts(top);
+    uint slice_num = (counts > _applied_phase_counts) ? _left_slice : _right_slice;
+    uint steps = (counts > _applied_phase_counts) ? 
+        counts - _applied_phase_counts : _applied_phase_counts - counts;
+
+    for(uint i = 0; i < steps; i++) pwm_retard_count(slice_num);
+    _applied_phase_counts = counts;
+}
+
 static void on_wrap_callback()
 {
     // determine which slice has caused the irq:
@@ -119,15 +298,25 @@ static void on_wrap_callback()
     if(mask & (1 << _left_slice)) {
         pwm_clear_irq(_left_slice);
 
-        if(_reloading_wrap_level) {
-            pwm_set_wrap(_left_slice, _selected_wrap);
-            pwm_set_wrap(_right_slice, _selected_wrap);
-            set_slice_match_levels(_left_slice, _selected_wrap, _selected_level);            
-            set_slice_match_levels(_right_slice, _selected_wrap, _selected_level);            
-            _reloading_wrap_level = false;
+        if(!is_burst_enabled()) {
+            // burst mode was turned off during an idle period
+            if(_burst_period_index != 0) {
+                _burst_period_index = 0;
+                set_burst_levels(0);
+            }
+            take_pending_reload();
+            if(_user_wrap_handler != NULL) _user_wrap_handler();
+            return;
         }
 
-        if(_user_wrap_handler != NULL) _user_wrap_handler();
+        // a new period has started, levels written now are latched at its end
+        uint cycle = _burst_on_periods + _burst_off_periods;
+        _burst_period_index = (_burst_period_index + 1) % cycle;
+        set_burst_levels(_burst_period_index + 1);
+        take_pending_reload();
+
+        // ADC capture sees the whole burst cycle as one period
+        if(_burst_period_index == 0 && _user_wrap_handler != NULL) _user_wrap_handler();
     }
 }
 
@@ -138,18 +327,29 @@ static void on_wrap_callback()
 void mach_pwm_start(uint hz, float duty, void (*wrap_handler)())
 {
     assert(duty >= 0 && duty <= 100);
-    if(_slices_are_running) mach_pwm_stop();
+    if(mach_pwm_is_running()) mach_pwm_stop();
+
+    if(_use_pio_bridge) {
+        mach_bridge_start(hz, duty, wrap_handler);
+        _bridge_is_running = true;
+        return;
+    }
+
+    pwm_timing_t timing;
+    pwm_timing_solve(hz, USE_DUAL_SLOPE, &timing);
 
-    uint divider;
-    uint16_t top = compute_pwm_top_and_divider(hz, USE_DUAL_SLOPE, &divider);
-    uint16_t match_a = compute_pwm_match_level(top, duty, true);  
+    // in phase shift mode both legs run at 50% with the same polarity
+    _slices_are_phase_shifted = _phase_shift_mode;
+    if(_slices_are_phase_shifted) duty = 50;
+    uint16_t match_a = compute_pwm_match_level(timing.top, duty, true);  
 
-    _selected_divider = divider;
-    _selected_wrap = top; 
+    _selected_divider = timing.div16;
+    _selected_wrap = timing.top; 
     _selected_level = match_a;
 
-    _left_slice = configure_pwm_slice(GPIO_LEFT_HIGH, GPIO_LEFT_LOW, top, match_a, divider, false);
-    _right_slice = configure_pwm_slice(GPIO_RIGHT_HIGH, GPIO_RIGHT_LOW, top, match_a, divider, true);
+    _left_slice = configure_pwm_slice(GPIO_LEFT_HIGH, GPIO_LEFT_LOW, &timing, match_a, false);
+    _right_slice = configure_pwm_slice(GPIO_RIGHT_HIGH, GPIO_RIGHT_LOW, &timing, match_a, 
+        !_slices_are_phase_shifted);
 
     _user_wrap_handler = wrap_handler; 
 
@@ -160,13 +360,84 @@ void mach_pwm_start(uint hz, float duty, void (*wrap_handler)())
     irq_set_exclusive_handler(PWM_IRQ_WRAP, on_wrap_callback);
     irq_set_enabled(PWM_IRQ_WRAP, true);
 
-    // both counters are in perfect sync from zero
+    // both counters are in perfect sync from zero, in phase shift mode
+    // the right counter is preloaded with the offset, it counts up from there
+    _applied_phase_counts = _slices_are_phase_shifted ? compute_phase_counts(timing.top) : 0;
     pwm_set_counter(_left_slice, 0);
-    pwm_set_counter(_right_slice, 0);
+    pwm_set_counter(_right_slice, _applied_phase_counts);
 
     // start both slices simulthaneously  
+    _burst_period_index = 0;
     pwm_set_mask_enabled(make_both_slices_bitmask()); 
     _slices_are_running = true;
+
+    // levels written to the running slices are latched at the first wrap
+    if(is_burst_enabled()) set_burst_levels(1);
+}
+
+//
+// Stops both slices, loads the timing and starts them again with the
+// counters preloaded for the phase, the period in progress is cut short.
+//
+static void restart_phase_shifted_slices(const pwm_timing_t *timing, uint16_t match)
+{
+    pwm_reload_cancel(&_left_reload);
+    pwm_reload_cancel(&_right_reload);
+    pwm_set_enabled(_left_slice, false);
+    pwm_set_enabled(_right_slice, false);
+
+    uint slices[2] = { _left_slice, _right_slice };
+    for(int i = 0; i < 2; i++) {
+        pwm_set_wrap(slices[i], timing->top);
+        pwm_timing_set_divider(slices[i], timing);
+        set_slice_match_levels(slices[i], timing->top, match);
+    }
+
+    _applied_phase_counts = compute_phase_counts(timing->top);
+    pwm_set_counter(_left_slice, 0);
+    pwm_set_counter(_right_slice, _applied_phase_counts);
+
+    _burst_period_index = 0;
+    pwm_set_mask_enabled(make_both_slices_bitmask());
+    if(is_burst_enabled()) set_burst_levels(1);
+}
+
+//
+// The phase shifted legs keep their offset in counts only while the
+// divider stays, the slices take the new values at different wraps and
+// a new divider would scale the counts of the window between them. So
+// the top changes alone and the offset is then retarded to the new top;
+// a frequency out of reach of the divider restarts both slices.
+//
+static void change_phase_shifted_waveform(uint hz)
+{
+    pwm_timing_t new_timing;
+    bool in_reach = pwm_timing_solve_with_divider(hz, USE_DUAL_SLOPE, _selected_divider, &new_timing);
+    if(!in_reach) pwm_timing_solve(hz, USE_DUAL_SLOPE, &new_timing);
+    uint16_t new_match = compute_pwm_match_level(new_timing.top, 50, true);
+
+    if(!in_reach) {
+        restart_phase_shifted_slices(&new_timing, new_match);
+    } else {
+        // the legs never wrap together, the right one wraps the offset
+        // before the left one; armed just after a left wrap, the right
+        // leg lands first and the left one follows it by the same time
+        _pending_timing = new_timing;
+        _pending_match = new_match;
+        __compiler_memory_barrier();
+        _reload_at_wrap = true;
+        while(_reload_at_wrap) tight_loop_contents();
+
+        // the offset in counts is kept by the counters, both updates
+        // land before it's scaled to the new top
+        pwm_reload_wait(&_right_reload);
+        pwm_reload_wait(&_left_reload);
+        apply_phase_offset(new_timing.top);
+    }
+
+    _selected_divider = new_timing.div16;
+    _selected_wrap = new_timing.top;
+    _selected_level = new_match;
 }
 
 /// @brief With running PWM slices change the frequency and the duty cycle.
@@ -174,36 +445,50 @@ void mach_pwm_start(uint hz, float duty, void (*wrap_handler)())
 /// @param duty New duty cycle
 void mach_pwm_change_waveform(uint hz, float duty)
 {
-    if(!_slices_are_running) return;
+    if(_bridge_is_running) {
+        mach_bridge_change_waveform(hz, duty);
+        return;
+    }
 
-    uint new_divider;
-    uint16_t new_top = compute_pwm_top_and_divider(hz, USE_DUAL_SLOPE, &new_divider);
-    uint16_t new_match = compute_pwm_match_level(new_top, duty, true);  
+    if(!_slices_are_running) return;
 
-    if(new_divider != _selected_divider) {
-        pwm_set_clkdiv_int_frac(_left_slice, new_divider, 0); 
-        pwm_set_clkdiv_int_frac(_right_slice, new_divider, 0); 
-        _selected_divider = new_divider;
+    if(_slices_are_phase_shifted) {
+        change_phase_shifted_waveform(hz);
+        return;
     }
 
-    _selected_wrap = new_top;
-    _selected_level = new_match; 
+    pwm_timing_t new_timing;
+    pwm_timing_solve(hz, USE_DUAL_SLOPE, &new_timing);
+    uint16_t new_match = compute_pwm_match_level(new_timing.top, duty, true);  
+
+    // both slices count in sync, so both engines land on the same wrap
+    reload_both_slices(&new_timing, new_match);
 
-    _reloading_wrap_level = true;
-    while(_reloading_wrap_level) tight_loop_contents();
+    _selected_divider = new_timing.div16;
+    _selected_wrap = new_timing.top;
+    _selected_level = new_match; 
 }
 
 /// @brief Returns true if PWM is running now.
 /// @return True if running, false if not running.
 bool mach_pwm_is_running()
 {
-    return _slices_are_running;
+    return _slices_are_running || _bridge_is_running;
 }
 
 /// @brief Stops the PWM signals if running now.
 void mach_pwm_stop()
 {
+    if(_bridge_is_running) {
+        mach_bridge_stop();
+        _bridge_is_running = false;
+        bring_all_outputs_low();
+    }
+
     if(_slices_are_running) {
+        _reload_at_wrap = false;
+        pwm_reload_cancel(&_left_reload);
+        pwm_reload_cancel(&_right_reload);
         pwm_set_enabled(_left_slice, false);      
         pwm_set_enabled(_right_slice, false);      
         _slices_are_running = false;
@@ -224,32 +509,6 @@ uint16_t compute_pwm_match_level(uint16_t top, float duty, bool inverted)
     return (uint16_t)(top * (100 - duty) / 100);  
 }
 
-// For the given frequency and PWM mode returns the TOP/WRAP value, 
-// if the divider_ptr is provided stores there the DIVIDER value.
-uint16_t compute_pwm_top_and_divider(uint hz, bool dual_slope, uint *divider_ptr)
-{
-    const uint max_top = 0xFFFF;
-    const int max_divider = 256;
-    uint32_t clocks_per_second = clock_get_hz(clk_sys);
-    uint periods_per_second = hz;
-
-    uint tops_per_second = dual_slope ? 
-        (2 * periods_per_second) : periods_per_second;
-
-    uint divider = 1;
-    for (; divider <= max_divider; divider++) {
-        // minus one cycle by RP2040 datasheet
-        uint top = clocks_per_second / (divider * tops_per_second) - 1;
-        if (top <= max_top) {
-            if (divider_ptr != NULL) *divider_ptr = divider;
-            return top;  
-        }     
-    }
-
-    if (divider_ptr != NULL) *divider_ptr = max_divider; 
-    return max_top;
-}
-
 static void bring_output_gpio_low(int gpio)
 {
     gpio_init(gpio); // set function GPIO_FUNC_SIO
@@ -0,0 +1,170 @@
+//
+// Zero-cross period capture. The zero_cross PIO program measures each
+// LC-tank period on the sense pin to 2 system clocks, 16ns at 125MHz.
+// The records are drained from its RX FIFO by DMA into a ring, so the
+// capture goes on at hundreds of kHz without any CPU interrupt. Readers
+// pick the records from the ring by the count of records written so far.
+//
+
+#include <math.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/clocks.h>
+#include "machine.h"
+#include "zero_cross.pio.h"
+
+// At 500K periods per second the 4096 records last for 8ms.
+#define RING_WORDS 4096
+#define RING_BYTES (RING_WORDS * sizeof(uint32_t))
+#define RING_SIZE_BITS 14
+#define RING_TRANSFERS 0xffffffff
+
+// shorter records are ringing at the edge, not tank periods
+#define MIN_PERIOD_CLOCKS 64
+
+static uint32_t _ring[RING_WORDS] __attribute__((aligned(RING_BYTES)));
+static const PIO _pio = pio0;
+static uint _sm;
+static uint _offset;
+static uint _dma_channel;
+static uint _read_count;
+static uint _written_base;
+static uint _lost_records;
+
+static uint get_written_count();
+
+/// @brief Loads the zero-cross program for the sense pin, not started yet.
+void mach_sense_init(uint gpio)
+{
+    _sm = pio_claim_unused_sm(_pio, true);
+    _offset = pio_add_program(_pio, &zero_cross_program);
+    zero_cross_program_init(_pio, _sm, _offset, gpio);
+    _dma_channel = dma_claim_unused_channel(true);
+}
+
+/// @brief Starts a new capture, the ring is refilled from its start.
+void mach_sense_start()
+{
+    dma_channel_abort(_dma_channel);
+    pio_sm_set_enabled(_pio, _sm, false);
+    pio_sm_clear_fifos(_pio, _sm);
+    pio_sm_restart(_pio, _sm);
+    pio_sm_exec(_pio, _sm, pio_encode_jmp(_offset));
+
+    dma_channel_config cfg = dma_channel_get_default_config(_dma_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_ring(&cfg, true, RING_SIZE_BITS);
+    channel_config_set_dreq(&cfg, pio_get_dreq(_pio, _sm, false));
+    dma_channel_configure(_dma_channel, &cfg, _ring, &_pio->rxf[_sm],
+        RING_TRANSFERS, true);
+
+    // the first record is measured from the program start, not from an edge
+    _read_count = 1;
+    _written_base = 0;
+    _lost_records = 0;
+    pio_sm_set_enabled(_pio, _sm, true);
+}
+
+/// @brief Stops the capture, the ring keeps the last records.
+void mach_sense_stop()
+{
+    pio_sm_set_enabled(_pio, _sm, false);
+}
+
+// Number of records written since the capture was started, modulo 2^32.
+// That is a multiple of the ring size, so count % RING_WORDS follows the
+// write address across the rearms.
+static uint get_written_count()
+{
+    return _written_base + RING_TRANSFERS - dma_channel_hw_addr(_dma_channel)->transfer_count;
+}
+
+// Period in system clocks, a record resolves it to 2 clocks.
+static inline uint32_t record_to_clocks(uint32_t record)
+{
+    return 2 * record + ZERO_CROSS_EXTRA_CLOCKS;
+}
+
+/// @brief Takes the periods captured since the last call.
+/// @param sum_clocks Receives the sum of the new periods in system clocks.
+/// @return Number of the new periods.
+uint mach_sense_read_periods(uint64_t *sum_clocks)
+{
+    // nothing until the first partial record is written
+    uint written = get_written_count();
+    if ((int)(written - _read_count) < 0) written = _read_count;
+    uint count = written - _read_count;
+
+    // records older than the ring size are overwritten already
+    if (count > RING_WORDS) {
+        _lost_records += count - RING_WORDS;
+        _read_count = written - RING_WORDS;
+    }
+
+    uint periods = 0;
+    uint64_t sum = 0;
+    while (_read_count != written) {
+        uint32_t clocks = record_to_clocks(_ring[_read_count % RING_WORDS]);
+        _read_count += 1;
+        if (clocks < MIN_PERIOD_CLOCKS) continue;
+        sum += clocks;
+        periods += 1;
+    }
+
+    // rearm the channel after its 2^32 - 1 transfers are done, the write
+    // address runs on from where it stopped and so does the count
+    if (!dma_channel_is_busy(_dma_channel)) {
+        _written_base += RING_TRANSFERS;
+        dma_channel_set_trans_count(_dma_channel, RING_TRANSFERS, true);
+    }
+
+    *sum_clocks = sum;
+    return periods;
+}
+
+/// @brief Computes the statistics of the periods held in the ring.
+/// @return False if there were no periods captured.
+bool mach_sense_get_stats(mach_sense_stats_t *stats)
+{
+    uint written = get_written_count();
+    bool ring_full = _written_base != 0 || written > RING_WORDS;
+    uint first = ring_full ? written - RING_WORDS : 1;
+    if (!ring_full && written < first) written = first;
+
+    uint count = 0;
+    uint32_t min_clocks = UINT32_MAX;
+    uint32_t max_clocks = 0;
+    uint64_t sum = 0;
+    for (uint i = first; i != written; i++) {
+        uint32_t clocks = record_to_clocks(_ring[i % RING_WORDS]);
+        if (clocks < MIN_PERIOD_CLOCKS) continue;
+        if (clocks < min_clocks) min_clocks = clocks;
+        if (clocks > max_clocks) max_clocks = clocks;
+        sum += clocks;
+        count += 1;
+    }
+
+    if (count == 0) return false;
+    uint32_t mean_clocks = (uint32_t)(sum / count);
+
+    // second pass for the deviations from the mean
+    uint64_t sum_squares = 0;
+    for (uint i = first; i < written; i++) {
+        uint32_t clocks = record_to_clocks(_ring[i % RING_WORDS]);
+        if (clocks < MIN_PERIOD_CLOCKS) continue;
+        int64_t deviation = (int64_t)clocks - mean_clocks;
+        sum_squares += deviation * deviation;
+    }
+
+    float ns_per_clock = 1e9f / clock_get_hz(clk_sys);
+    stats->count = count;
+    stats->lost = _lost_records;
+    stats->mean_hz = (float)clock_get_hz(clk_sys) / mean_clocks;
+    stats->mean_ns = mean_clocks * ns_per_clock;
+    stats->min_ns = min_clocks * ns_per_clock;
+    stats->max_ns = max_clocks * ns_per_clock;
+    stats->jitter_ns = sqrtf((float)(sum_squares / count)) * ns_per_clock;
+    return true;
+}
@@ -0,0 +1,64 @@
+//
+// Points and statistics of the SWEEP command, kept apart from the PWM
+// and ADC code so the host tests can run them.
+// SL (2025)
+//
+#include "machine_sweep.h"
+
+/// @brief Returns the number of points from start to stop, both included.
+uint mach_sweep_count_points(uint start_hz, uint stop_hz, uint step_hz)
+{
+    uint span_hz = (start_hz < stop_hz) ? (stop_hz - start_hz) : (start_hz - stop_hz);
+    return span_hz / step_hz + 1;
+}
+
+/// @brief Returns the frequency of the point, the sweep may go down.
+uint mach_sweep_point_hz(uint start_hz, uint stop_hz, uint step_hz, uint index)
+{
+    return (start_hz <= stop_hz) ? start_hz + index * step_hz : start_hz - index * step_hz;
+}
+
+// Integer square root, rounds down.
+static uint isqrt(uint64_t n)
+{
+    uint64_t root = 0, bit = 1ull << 62;
+    while (bit > n) bit >>= 2;
+    while (bit != 0) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint)root;
+}
+
+/// @brief Computes the AC RMS and the peak deviation of an ADC frame.
+void mach_sweep_compute_stats(const uint8_t *samples, uint num_samples, mach_sweep_stats_t *stats)
+{
+    stats->rms10 = 0;
+    stats->peak = 0;
+    if (num_samples == 0) return;
+
+    uint sum = 0;
+    uint64_t sum_squares = 0;
+    for (uint i = 0; i < num_samples; i++) {
+        uint sample = samples[i];
+        sum += sample;
+        sum_squares += sample * sample;
+    }
+
+    // variance times n^2 keeps everything in integers
+    uint64_t n = num_samples;
+    uint64_t variance_n2 = n * sum_squares - (uint64_t)sum * sum;
+    stats->rms10 = isqrt(100 * variance_n2) / num_samples;
+
+    uint mean = sum / num_samples;
+    for (uint i = 0; i < num_samples; i++) {
+        uint sample = samples[i];
+        uint deviation = (sample > mean) ? (sample - mean) : (mean - sample);
+        if (deviation > stats->peak) stats->peak = deviation;
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef _MACHINE_SWEEP_H
+#define _MACHINE_SWEEP_H
+
+#include "pico/stdlib.h"
+
+// Statistics of one sweep point.
+typedef struct
+{
+  uint rms10;   // AC RMS in tenths of ADC units
+  uint peak;    // largest deviation from the mean
+} mach_sweep_stats_t;
+
+uint mach_sweep_count_points(uint start_hz, uint stop_hz, uint step_hz);
+uint mach_sweep_point_hz(uint start_hz, uint stop_hz, uint step_hz, uint index);
+void mach_sweep_compute_stats(const uint8_t *samples, uint num_samples, mach_sweep_stats_t *stats);
+
+// _MACHINE_SWEEP_H
+#endif
@@ -0,0 +1,65 @@
+//
+// Fixed-point PI loop of the resonance tracking, kept apart from the
+// PWM and the sense code so the host tests can run it on a simulated
+// LC tank.
+// SL (2025)
+//
+#include <stdlib.h>
+#include "machine_track.h"
+
+#define TRACK_LOCK_COUNT 16          // loop steps within tolerance to be locked
+#define TRACK_LOCK_TOLERANCE_SHIFT 8 // tolerance is top/256
+
+/// @brief Starts the loop from the top the drive runs with.
+void mach_track_reset(mach_track_t *track, uint16_t base_top)
+{
+    track->base_top = base_top;
+    track->integral = 0;
+    track->lock_count = 0;
+}
+
+/// @brief One step of the loop. The error is the difference between the
+/// drive period and the given number of mean tank periods, in PWM counts.
+/// The PI output is an offset to the base top, limited to half and twice it.
+/// @param sum_clocks Sum of the tank periods measured since the last step.
+/// @param periods Number of the tank periods, not 0.
+/// @param waves Tank periods per drive period.
+/// @param div16 PWM divider in 1/16 steps.
+/// @param top PWM top the drive runs with now.
+/// @return The new top.
+uint16_t mach_track_step(mach_track_t *track, uint64_t sum_clocks, uint periods,
+    uint waves, uint div16, uint16_t top)
+{
+    // top which makes the drive period max_waves mean tank periods long
+    uint64_t target_clocks16 = sum_clocks * waves * 16 / periods;
+    int32_t target_top = (int32_t)(target_clocks16 / div16) - 1;
+    int32_t error = target_top - top;
+
+    // integral is limited to a quarter of the start top
+    int32_t integral_limit = ((int32_t)track->base_top << 8) / 4;
+    track->integral += track->ki * error;
+    if (track->integral > integral_limit) track->integral = integral_limit;
+    if (track->integral < -integral_limit) track->integral = -integral_limit;
+
+    int32_t new_top = track->base_top + (track->kp * error + track->integral) / 256;
+    int32_t min_top = track->base_top / 2;
+    int32_t max_top = track->base_top * 2;
+    if (max_top > 0xffff) max_top = 0xffff;
+    if (new_top < min_top) new_top = min_top;
+    if (new_top > max_top) new_top = max_top;
+
+    int32_t tolerance = (top >> TRACK_LOCK_TOLERANCE_SHIFT) + 1;
+    if (abs(error) <= tolerance) {
+        if (track->lock_count < TRACK_LOCK_COUNT) track->lock_count += 1;
+    } else {
+        track->lock_count = 0;
+    }
+
+    return (uint16_t)new_top;
+}
+
+/// @brief Returns true once the error has stayed within tolerance long enough.
+bool mach_track_is_locked(const mach_track_t *track)
+{
+    return track->lock_count >= TRACK_LOCK_COUNT;
+}
@@ -0,0 +1,22 @@
+#ifndef _MACHINE_TRACK_H
+#define _MACHINE_TRACK_H
+
+#include "pico/stdlib.h"
+
+// Resonance tracking loop, gains are Q8 fixed point, 256 is the gain of 1.
+typedef struct
+{
+  int kp;
+  int ki;
+  uint16_t base_top;  // top the drive was started with
+  int32_t integral;   // Q8
+  uint lock_count;    // loop steps within tolerance in a row
+} mach_track_t;
+
+void mach_track_reset(mach_track_t *track, uint16_t base_top);
+uint16_t mach_track_step(mach_track_t *track, uint64_t sum_clocks, uint periods,
+  uint waves, uint div16, uint16_t top);
+bool mach_track_is_locked(const mach_track_t *track);
+
+// _MACHINE_TRACK_H
+#endif
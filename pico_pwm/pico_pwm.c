@@ -3,6 +3,17 @@
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
+#include "pwm_timing.h"
+#include "pwm_playback.h"
+
+// duty is modulated by a sine of this many PWM periods
+#define SINE_TABLE_LENGTH 100
+
+// duty swing of the sine around 50%
+#define SINE_AMPLITUDE 0.25f
+
+static uint32_t sine_table[SINE_TABLE_LENGTH];
+static pwm_playback_t playback;
 
 static bool ledInitDone = 0;
 static void set_led(bool on);
@@ -30,34 +41,9 @@ int main()
     }
 }
 
-static uint16_t choose_pwm_top_and_divider(
-    uint periods_per_second, bool dual_slope, uint *divider_ptr)
-{
-    const uint max_top = 0xFFFF;
-    const int max_divider = 256;
-    uint32_t clocks_per_second = clock_get_hz(clk_sys);
-
-    uint tops_per_second = dual_slope ? 
-        (2 * periods_per_second) : periods_per_second;
-
-    uint divider = 1;
-    for (; divider <= max_divider; divider++) {
-        // minus one cycle by RP2040 datasheet
-        uint top = clocks_per_second / (divider * tops_per_second) - 1;
-        if (top <= max_top) {
-            *divider_ptr = divider;
-            return top;  
-        }     
-    }
-
-    *divider_ptr = max_divider; 
-    return max_top;
-}
-
 static void configure_pwm(uint gpio)
 {
     uint hz = 8300;
-    float duty = 0.25;
 
     gpio_set_function(gpio, GPIO_FUNC_PWM);
     gpio_set_function(gpio + 1, GPIO_FUNC_PWM);
@@ -68,11 +54,9 @@ static void configure_pwm(uint gpio)
     // dual-slope operation
     const bool dual_slope = false;
     pwm_config config = pwm_get_default_config();
-    uint divider;
-    uint16_t count_top = choose_pwm_top_and_divider(hz, dual_slope, &divider);
-    pwm_config_set_phase_correct(&config, dual_slope);
-    pwm_config_set_wrap(&config, count_top);
-    pwm_config_set_clkdiv_int(&config, divider);
+    pwm_timing_t timing;
+    pwm_timing_solve(hz, dual_slope, &timing);
+    pwm_timing_apply(&config, &timing);
 
     // channel A is not inverted, channel B is inverted 
     pwm_config_set_output_polarity(&config, false, true);
@@ -80,14 +64,23 @@ static void configure_pwm(uint gpio)
     // load into slice but not run
     pwm_init(slice_num, &config, false); 
 
-    // set PWM compare values for both A/B channels 
-    uint high_cycles = (uint)(count_top * duty);
+    // start at the middle of the sine, the playback takes over from the next period
+    uint16_t high_cycles = pwm_timing_level(&timing, 0.5f);
     pwm_set_both_levels(slice_num, high_cycles, high_cycles);
+    printf("pwm %.2fHz top=%d div=%d+%d/16\n", timing.hz, timing.top,
+        pwm_timing_div_int(&timing), pwm_timing_div_frac(&timing));
 
     pwm_set_counter(slice_num, 0);
 
     // start the counter
     pwm_set_enabled(slice_num, true);
+
+    // sine-weighted duty, one table entry per PWM period, played by DMA
+    pwm_playback_init(&playback, slice_num);
+    pwm_playback_fill_sine(sine_table, SINE_TABLE_LENGTH, &timing, SINE_AMPLITUDE);
+    pwm_playback_start(&playback, sine_table, SINE_TABLE_LENGTH, true);
+    printf("sine modulation %.2fHz duty %.2f..%.2f\n", timing.hz / SINE_TABLE_LENGTH,
+        0.5f - SINE_AMPLITUDE, 0.5f + SINE_AMPLITUDE);
 }
 
 static void run_startup_led_welcome()
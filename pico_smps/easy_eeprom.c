@@ -99,3 +99,51 @@ void easy_eeprom_scan_bus()
     if (found_addr >= 0) printf("Done: found bus address 0x%02x\n", found_addr);
     else printf("Done, no devices was found.\n");
 }
+
+// Starts writing bytes which all belong to one EEPROM page and returns 
+// without waiting. Address and data are pushed straight into the I2C TX
+// FIFO (16 entries), so the controller shifts them out on its own. Returns
+// false if the bus is still busy or the page doesn't fit into the FIFO.
+// Caller must give the chip its write cycle time before the next write.
+bool easy_eeprom_write_page_async(uint16_t address, const uint8_t *source, uint len)
+{
+    uint8_t memaddr_buf[4];
+    size_t memaddr_len = fill_memaddr_buf(memaddr_buf, address, EEPROM_BYTESPERPAGE);
+    if (len == 0 || len > EEPROM_BYTESPERPAGE) return false;
+    if (memaddr_len + len > i2c_get_write_available(EEPROM_I2C_PORT)) return false;
+    if (easy_eeprom_is_busy()) return false;
+
+    i2c_hw_t *hw = i2c_get_hw(EEPROM_I2C_PORT);
+    hw->enable = 0;
+    hw->tar = EEPROM_DEVICEADDR;
+    hw->enable = 1;
+
+    // forget about the previous transfer abort if any
+    (void)hw->clr_tx_abrt;
+
+    for (size_t i = 0; i < memaddr_len; i++) hw->data_cmd = memaddr_buf[i];
+    for (uint i = 0; i < len; i++) {
+        bool last = (i == len - 1);
+        hw->data_cmd = source[i] | (last ? I2C_IC_DATA_CMD_STOP_BITS : 0);
+    }
+
+    return true;
+}
+
+// Returns true while the last async write is still on the bus.
+bool easy_eeprom_is_busy()
+{
+    i2c_hw_t *hw = i2c_get_hw(EEPROM_I2C_PORT);
+    if (!(hw->status & I2C_IC_STATUS_TFE_BITS)) return true;
+    return (hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS) != 0;
+}
+
+// Returns true if the last async write was aborted (chip didn't ACK), 
+// the error is cleared by the call.
+bool easy_eeprom_take_error()
+{
+    i2c_hw_t *hw = i2c_get_hw(EEPROM_I2C_PORT);
+    if (!(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS)) return false;
+    (void)hw->clr_tx_abrt;
+    return true;
+}
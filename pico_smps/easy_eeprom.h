@@ -13,6 +13,11 @@ void easy_eeprom_scan_bus();
 int easy_eeprom_read_bytes(uint16_t address, uint8_t *target, uint len);
 int easy_eeprom_write_bytes(uint16_t address, uint8_t *source, uint len);
 
+// Non-blocking single page write, see easy_eeprom.c for details.
+bool easy_eeprom_write_page_async(uint16_t address, const uint8_t *source, uint len);
+bool easy_eeprom_is_busy();
+bool easy_eeprom_take_error();
+
 #ifdef __cplusplus
 }
 #endif
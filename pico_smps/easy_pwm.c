@@ -5,31 +5,26 @@
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
+#include "hardware/gpio.h"
 #include "easy_pwm.h"
+#include "pwm_timing.h"
+#include "pwm_reload.h"
+#include "pwm_playback.h"
 
-static uint16_t choose_pwm_top_and_divider(
-    uint periods_per_second, bool dual_slope, uint *divider_ptr)
-{
-    const uint max_top = 0xFFFF;
-    const int max_divider = 256;
-    uint32_t clocks_per_second = clock_get_hz(clk_sys);
-
-    uint tops_per_second = dual_slope ? 
-        (2 * periods_per_second) : periods_per_second;
-
-    uint divider = 1;
-    for (; divider <= max_divider; divider++) {
-        // minus one cycle by RP2040 datasheet
-        uint top = clocks_per_second / (divider * tops_per_second) - 1;
-        if (top <= max_top) {
-            *divider_ptr = divider;
-            return top;  
-        }     
-    }
+// Ramped transitions are played by DMA from a duty table, one entry per
+// PWM period, so the CPU doesn't step them. There is one table and its
+// DMA channels are bound to the last slice used with the ramped calls.
+#define MAX_RAMP_PERIODS 1000
 
-    *divider_ptr = max_divider; 
-    return max_top;
-}
+static uint s_ramp_periods = 100;
+static uint32_t s_ramp_table[MAX_RAMP_PERIODS];
+static pwm_playback_t s_playback;
+static pwm_reload_t s_reload;
+static int s_ramp_slice = -1;
+static pwm_timing_t s_ramp_timing;
+
+// GPIO of the PWM ramping down in easy_pwm_stop(), -1 if none.
+static int s_stopping_gpio = -1;
 
 void easy_pwm_enable(uint gpio, uint hz, float duty)
 {
@@ -42,11 +37,9 @@ void easy_pwm_enable(uint gpio, uint hz, float duty)
     // dual-slope operation
     const bool dual_slope = false;
     pwm_config config = pwm_get_default_config();
-    uint divider;
-    uint16_t count_top = choose_pwm_top_and_divider(hz, dual_slope, &divider);
-    pwm_config_set_phase_correct(&config, dual_slope);
-    pwm_config_set_wrap(&config, count_top);
-    pwm_config_set_clkdiv_int(&config, divider);
+    pwm_timing_t timing;
+    pwm_timing_solve(hz, dual_slope, &timing);
+    pwm_timing_apply(&config, &timing);
 
     // channel A is not inverted, channel B is inverted 
     pwm_config_set_output_polarity(&config, false, true);
@@ -55,7 +48,7 @@ void easy_pwm_enable(uint gpio, uint hz, float duty)
     pwm_init(slice_num, &config, false); 
 
     // set PWM compare values for both A/B channels 
-    uint high_cycles = (uint)(count_top * duty);
+    uint16_t high_cycles = pwm_timing_level(&timing, duty);
     pwm_set_both_levels(slice_num, high_cycles, high_cycles);
 
     pwm_set_counter(slice_num, 0);
@@ -68,6 +61,140 @@ void easy_pwm_disable(uint gpio)
 {
     // figure out which slice we just connected to the pin
     uint slice_num = pwm_gpio_to_slice_num(gpio);
+    if (s_stopping_gpio == (int)gpio) s_stopping_gpio = -1;
+    if (s_ramp_slice == (int)slice_num) {
+        pwm_playback_stop(&s_playback);
+        pwm_reload_cancel(&s_reload);
+    }
     pwm_set_enabled(slice_num, false);
     gpio_set_function(gpio, GPIO_FUNC_NULL);
 }
+
+// Stops the slice and drives both its pins low, safe to call from IRQ.
+// Pins stay overridden until easy_pwm_enable() sets their function again.
+void __not_in_flash_func(easy_pwm_trip)(uint gpio)
+{
+    uint slice_num = pwm_gpio_to_slice_num(gpio);
+    hw_clear_bits(&pwm_hw->slice[slice_num].csr, PWM_CH0_CSR_EN_BITS);
+    for (uint pin = gpio; pin <= gpio + 1; pin++) {
+        hw_write_masked(&iobank0_hw->io[pin].ctrl,
+            GPIO_OVERRIDE_LOW << IO_BANK0_GPIO0_CTRL_OUTOVER_LSB,
+            IO_BANK0_GPIO0_CTRL_OUTOVER_BITS);
+    }
+}
+
+/// @brief Sets the length of the ramped transitions, 0 makes them immediate.
+void easy_pwm_set_ramp_periods(uint periods)
+{
+    s_ramp_periods = (periods < MAX_RAMP_PERIODS) ? periods : MAX_RAMP_PERIODS;
+}
+
+static void bind_ramp(uint slice_num)
+{
+    if (s_ramp_slice == (int)slice_num) return;
+    if (s_ramp_slice >= 0) {
+        pwm_playback_deinit(&s_playback);
+        pwm_reload_deinit(&s_reload);
+    }
+    pwm_playback_init(&s_playback, slice_num);
+    pwm_reload_init(&s_reload, slice_num);
+    s_ramp_slice = slice_num;
+}
+
+// A tripped or disabled slice doesn't wrap, DMA paced by the wrap never ends.
+static inline bool is_slice_enabled(uint slice_num)
+{
+    return (pwm_hw->slice[slice_num].csr & PWM_CH0_CSR_EN_BITS) != 0;
+}
+
+// Duty produced by the slice now, the ramp may be half way.
+static float get_current_duty(uint slice_num)
+{
+    uint16_t level = (uint16_t)(pwm_hw->slice[slice_num].cc & 0xffff);
+    return pwm_timing_duty(&s_ramp_timing, level);
+}
+
+static void play_ramp(uint slice_num, float from_duty, float to_duty)
+{
+    if (s_ramp_periods == 0) {
+        uint16_t level = pwm_timing_level(&s_ramp_timing, to_duty);
+        pwm_set_both_levels(slice_num, level, level);
+        return;
+    }
+
+    pwm_playback_fill_ramp(s_ramp_table, s_ramp_periods, &s_ramp_timing, from_duty, to_duty);
+    pwm_playback_start(&s_playback, s_ramp_table, s_ramp_periods, false);
+}
+
+/// @brief Starts the PWM at zero duty and ramps it up to the duty.
+void easy_pwm_start(uint gpio, uint hz, float duty)
+{
+    uint slice_num = pwm_gpio_to_slice_num(gpio);
+    if (s_stopping_gpio == (int)gpio) s_stopping_gpio = -1;
+    bind_ramp(slice_num);
+    pwm_timing_solve(hz, false, &s_ramp_timing);
+    easy_pwm_enable(gpio, hz, 0);
+    play_ramp(slice_num, 0, duty);
+}
+
+/// @brief Starts ramping the duty down to zero and returns, easy_pwm_poll()
+/// disables the PWM when the ramp is played. A trip ends the ramp early.
+void easy_pwm_stop(uint gpio)
+{
+    uint slice_num = pwm_gpio_to_slice_num(gpio);
+    if (s_ramp_slice == (int)slice_num && is_slice_enabled(slice_num)) {
+        play_ramp(slice_num, get_current_duty(slice_num), 0);
+    }
+    s_stopping_gpio = gpio;
+}
+
+/// @brief Finishes the stop started by easy_pwm_stop(), call it from the main loop.
+/// @return True if the PWM was disabled by this call.
+bool easy_pwm_poll()
+{
+    if (s_stopping_gpio < 0) return false;
+
+    uint gpio = s_stopping_gpio;
+    uint slice_num = pwm_gpio_to_slice_num(gpio);
+    bool ramping = s_ramp_slice == (int)slice_num && is_slice_enabled(slice_num) &&
+        pwm_playback_is_busy(&s_playback);
+    if (ramping) return false;
+
+    easy_pwm_disable(gpio);
+    return true;
+}
+
+/// @brief Changes the waveform of the running PWM without stopping it, the new
+/// frequency is taken at a period boundary and the duty is ramped from there.
+/// A tripped or stopped PWM is left as it is, only easy_pwm_start() runs it again.
+void easy_pwm_change(uint gpio, uint hz, float duty)
+{
+    uint slice_num = pwm_gpio_to_slice_num(gpio);
+    if (s_ramp_slice != (int)slice_num) {
+        easy_pwm_start(gpio, hz, duty);
+        return;
+    }
+    if (!is_slice_enabled(slice_num)) return;
+
+    pwm_playback_stop(&s_playback);
+    float current_duty = get_current_duty(slice_num);
+
+    pwm_timing_t timing;
+    pwm_timing_solve(hz, false, &timing);
+    if (timing.top != s_ramp_timing.top || timing.div16 != s_ramp_timing.div16) {
+        uint16_t level = pwm_timing_level(&timing, current_duty);
+        pwm_reload_start(&s_reload, &timing, level, level);
+        while (pwm_reload_is_pending(&s_reload) && is_slice_enabled(slice_num)) {
+            tight_loop_contents();
+        }
+
+        // tripped while waiting for the period boundary
+        if (!is_slice_enabled(slice_num)) {
+            pwm_reload_cancel(&s_reload);
+            return;
+        }
+        s_ramp_timing = timing;
+    }
+
+    play_ramp(slice_num, current_duty, duty);
+}
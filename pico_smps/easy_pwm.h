@@ -10,6 +10,12 @@ extern "C" {
 
 void easy_pwm_enable(uint gpio, uint hz, float duty);
 void easy_pwm_disable(uint gpio);
+void easy_pwm_trip(uint gpio);
+void easy_pwm_set_ramp_periods(uint periods);
+void easy_pwm_start(uint gpio, uint hz, float duty);
+void easy_pwm_stop(uint gpio);
+bool easy_pwm_poll();
+void easy_pwm_change(uint gpio, uint hz, float duty);
 
 #ifdef __cplusplus
 }
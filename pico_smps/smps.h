@@ -25,11 +25,22 @@ extern volatile bool _smps_limit_occured;
 
 // PIO functions.
 void smps_pio_start_repeater();
+uint smps_pio_poll_limit_events();
+void smps_pio_report_limit_stats();
+
+// Overcurrent trip diagnostics.
+typedef struct smps_trip_t {
+    uint64_t time_us;
+    uint8_t peak_reading;
+    float peak_amps;
+} smps_trip_t;
 
 // Core1 current sensor functions.
 void smps_core1_entry(); 
 void smps_current_sensor_init();
 float smps_current_sensor_get_amps();
+void smps_current_sensor_update_limit();
+bool smps_current_sensor_take_trip(smps_trip_t *trip);
 
 // Utility functions.
 void smps_led_init();
@@ -50,6 +61,7 @@ extern memory_t _smps_memory;
 void smps_memory_init();
 void smps_memory_restore();
 void smps_memory_save();
+void smps_memory_flush();
 
 // _SMPS_GLOBALS_H_
 #endif
\ No newline at end of file
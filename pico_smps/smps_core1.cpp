@@ -1,23 +1,49 @@
-
 #include "smps.h"
 
 #include "pico/multicore.h"
 #include "hardware/gpio.h"
 #include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "easy_pwm.h"
 
 static uint8_t compute_average(uint8_t *array, uint length);
 static void learn_current_sensor_zero_reading();  
 static uint8_t get_average_adc_sample();
 static float convert_adc_to_amps(uint8_t adc_reading);  
+static void start_sampling();
+static void dma_block_handler();
+static void trip(uint8_t peak_reading);
 
 static uint8_t _current_sensor_zero_reading = CURRENT_SENSOR_ZERO_READING;
 
-// Pi Pico ADC sample rate is 600K per second,
-// so 100*100=10K and 60 measures per second
-static uint8_t _adc_array_level_1[100];
-static uint8_t _adc_array_level_2[100];
-static int _adc_index_level_1 = 0;
-static int _adc_index_level_2 = 0;
+// ADC runs free at 48MHz/(1+191)=250K samples per second, two DMA channels
+// chained to each other fill 64-sample blocks in turns, so a block is ready
+// every 256us. The display filter is a running sum of the last 16 block
+// sums (~4ms window) updated once per block. The overcurrent trip compares
+// each block sum against raw thresholds, so PWM is cut within one block
+// time plus the handler run time.
+#define ADC_CLKDIV 191
+#define BLOCK_SAMPLES 64
+#define BLOCK_SHIFT 6
+#define WINDOW_BLOCKS 16
+#define WINDOW_SHIFT 4
+
+static uint8_t _adc_blocks[2][BLOCK_SAMPLES] __attribute__((aligned(BLOCK_SAMPLES)));
+static uint _dma_channels[2];
+
+static uint _block_sums[WINDOW_BLOCKS];
+static uint _block_index = 0;
+static volatile uint _window_sum = 0;
+static volatile uint _block_count = 0;
+
+// trip thresholds in block sum units, high in upper half-word,
+// packed to be read by the handler in one access
+static volatile uint32_t _trip_thresholds = 0xffff0000;
+
+static smps_trip_t _trip;
+static volatile bool _trip_pending = false;
 static int _overcurrent_count = 0;
 
 void smps_current_sensor_init()
@@ -29,8 +55,11 @@ void smps_current_sensor_init()
      
     learn_current_sensor_zero_reading(); 
 
-    memset(_adc_array_level_1, CURRENT_SENSOR_ZERO_READING, sizeof(_adc_array_level_1));
-    memset(_adc_array_level_2, CURRENT_SENSOR_ZERO_READING, sizeof(_adc_array_level_2));
+    uint zero_block_sum = _current_sensor_zero_reading << BLOCK_SHIFT;
+    for (int i = 0; i < WINDOW_BLOCKS; i++) _block_sums[i] = zero_block_sum;
+    _window_sum = zero_block_sum << WINDOW_SHIFT;
+
+    smps_current_sensor_update_limit();
 
     multicore_launch_core1(smps_core1_entry);
 }
@@ -40,6 +69,33 @@ float smps_current_sensor_get_amps()
     return convert_adc_to_amps(get_average_adc_sample());
 }
 
+// Converts amp_limit into raw ADC block sums, call when the limit changes.
+void smps_current_sensor_update_limit()
+{
+    int zero_sum = _current_sensor_zero_reading << BLOCK_SHIFT;
+    int span = CURRENT_SENSOR_MAX_READING - _current_sensor_zero_reading;
+    int delta_sum = (int)(_smps_memory.amp_limit * span / CURRENT_SENSOR_MAX_AMPS) << BLOCK_SHIFT;
+
+    // readings are clamped to max amps, so a limit at max never trips
+    int high_sum = 0xffff, low_sum = 0;
+    if (_smps_memory.amp_limit < CURRENT_SENSOR_MAX_AMPS) {
+        high_sum = MIN(zero_sum + delta_sum, 0xffff);
+        low_sum = MAX(zero_sum - delta_sum, 0);
+    }
+
+    _trip_thresholds = ((uint32_t)high_sum << 16) | (uint32_t)low_sum;
+}
+
+// Returns true once per trip with its diagnostics.
+bool smps_current_sensor_take_trip(smps_trip_t *trip)
+{
+    if (!_trip_pending) return false;
+    *trip = _trip;
+    trip->peak_amps = convert_adc_to_amps(trip->peak_reading);
+    _trip_pending = false;
+    return true;
+}
+
 inline uint8_t read_adc_byte()
 {
     uint16_t value12bit = adc_read();
@@ -62,7 +118,7 @@ static uint8_t compute_average(uint8_t *array, uint length)
 
 uint8_t get_average_adc_sample()
 {
-    return compute_average(_adc_array_level_2, sizeof(_adc_array_level_2));
+    return (uint8_t)(_window_sum >> (BLOCK_SHIFT + WINDOW_SHIFT));
 }
 
 float convert_adc_to_amps(uint8_t adc_reading)
@@ -84,27 +140,93 @@ float convert_adc_to_amps(uint8_t adc_reading)
     return amps * (reversed ? -1 : 1);
 }   
 
-// Core1 procedure runs in parallel to the main loop running in Core0.
-void smps_core1_entry() 
+static void start_sampling()
+{
+    // 8-bit samples into FIFO, DREQ at each sample
+    adc_fifo_setup(true, true, 1, false, true);
+    adc_set_clkdiv(ADC_CLKDIV);
+
+    _dma_channels[0] = dma_claim_unused_channel(true);
+    _dma_channels[1] = dma_claim_unused_channel(true);
+
+    for (int i = 0; i < 2; i++) {
+        uint channel = _dma_channels[i];
+        dma_channel_config cfg = dma_channel_get_default_config(channel);
+        channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+        channel_config_set_read_increment(&cfg, false);
+        channel_config_set_write_increment(&cfg, true);
+        channel_config_set_dreq(&cfg, DREQ_ADC);
+        channel_config_set_chain_to(&cfg, _dma_channels[i ^ 1]);
+        dma_channel_configure(channel, &cfg, _adc_blocks[i], &adc_hw->fifo,
+            BLOCK_SAMPLES, false);
+    }
+
+    // interrupt is served by core1 as it is enabled here 
+    dma_hw->ints1 = (1u << _dma_channels[0]) | (1u << _dma_channels[1]);
+    dma_channel_set_irq1_enabled(_dma_channels[0], true);
+    dma_channel_set_irq1_enabled(_dma_channels[1], true);
+    irq_set_exclusive_handler(DMA_IRQ_1, dma_block_handler);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    adc_fifo_drain();
+    dma_channel_start(_dma_channels[0]);
+    adc_run(true);
+}
+
+// Called at each block end, the other channel is already filling its block.
+static void __not_in_flash_func(dma_block_handler)()
 {
-    while (1) {
-        _adc_array_level_1[_adc_index_level_1] = read_adc_byte();
-
-        if(++_adc_index_level_1 == sizeof(_adc_array_level_1)) {
-            _adc_index_level_1 = 0;
-            
-            uint8_t avg1 = compute_average(_adc_array_level_1, sizeof(_adc_array_level_1));
-            _adc_array_level_2[_adc_index_level_2] = avg1;
-            if (++_adc_index_level_2 == sizeof(_adc_array_level_2)) { 
-              _adc_index_level_2 = 0;
-
-                // at the end of each buffer cycle check amp limit
-                float amps = convert_adc_to_amps(get_average_adc_sample());
-                if (abs(amps) > _smps_memory.amp_limit) {
-                    smps_enter_alarm_mode();
-                    _overcurrent_count += 1;
-                }
-            }
+    for (int i = 0; i < 2; i++) {
+        uint channel = _dma_channels[i];
+        if (!(dma_hw->ints1 & (1u << channel))) continue;
+        dma_hw->ints1 = 1u << channel;
+
+        uint sum = 0;
+        uint8_t low = 0xff, high = 0;
+        const uint8_t *samples = _adc_blocks[i];
+        for (int j = 0; j < BLOCK_SAMPLES; j++) {
+            uint8_t sample = samples[j];
+            sum += sample;
+            if (sample > high) high = sample;
+            if (sample < low) low = sample;
         }
+
+        // the channel stays ready to be triggered by the chain
+        dma_channel_set_write_addr(channel, _adc_blocks[i], false);
+
+        _window_sum = _window_sum - _block_sums[_block_index] + sum;
+        _block_sums[_block_index] = sum;
+        _block_index = (_block_index + 1) % WINDOW_BLOCKS;
+        _block_count += 1;
+
+        uint32_t thresholds = _trip_thresholds;
+        if (sum > (thresholds >> 16)) trip(high); 
+        else if (sum < (thresholds & 0xffff)) trip(low);
     }
 }
+
+// Cuts PWM right from the handler, relays are left to Core0.
+static void __not_in_flash_func(trip)(uint8_t peak_reading)
+{
+    easy_pwm_trip(PWM_PIN);
+
+    if (!_trip_pending) {
+        _trip.time_us = time_us_64();
+        _trip.peak_reading = peak_reading;
+        _trip.peak_amps = 0;
+        _trip_pending = true;
+        _overcurrent_count += 1;
+    }
+
+    // wake Core0 if it waits for events
+    __sev();
+}
+
+// Core1 procedure runs in parallel to the main loop running in Core0.
+// It only serves the DMA interrupts and sleeps in between.
+void smps_core1_entry() 
+{
+    start_sampling();
+
+    while (1) __wfe();
+}
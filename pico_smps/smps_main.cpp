@@ -2,12 +2,19 @@
 #include "smps.h"
 
 #include "easy_pwm.h"
-#include "easy_buttons.h"
+#include "input.h"
 
 static void button_callback(uint gpio, bool pressed);
+static void process_buttons_until(absolute_time_t until);
 static void enable_relay(uint relay_gpio, bool on);
 static void enable_all_relays(bool on);
 
+// limit event ring must be polled before it wraps
+#define LIMIT_POLL_MS 20
+
+// PWM duty goes up and down over this many periods
+#define PWM_RAMP_PERIODS 200
+
 // Global state.
 bool _smps_pwm_running = false;
 int _smps_mode = SMPS_MODE_HZ;
@@ -25,24 +32,29 @@ int main()
     smps_memory_restore();
     smps_current_sensor_init();
     smps_pio_start_repeater();  
+    easy_pwm_set_ramp_periods(PWM_RAMP_PERIODS);
     smps_display_repaint();
 
-    easy_buttons_register(BUTTON_MODE_PIN, button_callback, true, true);
-    easy_buttons_register(BUTTON_UP_PIN, button_callback, true, true);
-    easy_buttons_register(BUTTON_DOWN_PIN, button_callback, true, true);
-    easy_buttons_register(BUTTON_ON_PIN, button_callback, true, false);
+    // button events carry the GPIO number as the key code
+    input_init();
+    input_register_key(BUTTON_MODE_PIN, BUTTON_MODE_PIN, true, true);
+    input_register_key(BUTTON_UP_PIN, BUTTON_UP_PIN, true, true);
+    input_register_key(BUTTON_DOWN_PIN, BUTTON_DOWN_PIN, true, true);
+    input_register_key(BUTTON_ON_PIN, BUTTON_ON_PIN, true, false);
 
     const int cycle_ms = 500; 
   
     while(true) {
         if (_smps_limit_occured) smps_sound_enable(true);
         smps_led_set(true); 
-        easy_buttons_sleep_ms(cycle_ms / 2); 
+        process_buttons_until(make_timeout_time_ms(cycle_ms / 2)); 
         if (_smps_limit_occured) smps_sound_enable(false);
         _smps_limit_occured = false;  
 
         smps_led_set(false); 
-        easy_buttons_sleep_ms(cycle_ms / 2);
+        process_buttons_until(make_timeout_time_ms(cycle_ms / 2));
+
+        if (_smps_cycle_count % 2 == 0) smps_pio_report_limit_stats();
 
         smps_display_repaint();
         _smps_cycle_count += 1;
@@ -67,32 +79,53 @@ static void toggle_pwm_running_state()
 {
     _smps_pwm_running = !_smps_pwm_running;
     if (_smps_pwm_running) {
-        easy_pwm_enable(PWM_PIN, _smps_memory.pwm_hz, _smps_memory.pwm_duty);
+        easy_pwm_start(PWM_PIN, _smps_memory.pwm_hz, _smps_memory.pwm_duty);
     }
     else {
-        easy_pwm_disable(PWM_PIN);
+        // the relays are released when the ramp down is played
+        easy_pwm_stop(PWM_PIN);
         _smps_alarm_occured = false;
+        smps_memory_flush();
     }
 
     smps_display_repaint();
 
-    enable_all_relays(_smps_pwm_running);
+    if (_smps_pwm_running) enable_all_relays(true);
 }
 
 static void maybe_update_pwm_waveform()
 {
     if (_smps_pwm_running) {
-        easy_pwm_disable(PWM_PIN);
-        easy_pwm_enable(PWM_PIN, _smps_memory.pwm_hz, _smps_memory.pwm_duty);
+        easy_pwm_change(PWM_PIN, _smps_memory.pwm_hz, _smps_memory.pwm_duty);
     }
 }
 
-static void button_callback(uint gpio, bool pressed)
+// Sleeps until the deadline handling the button events and
+// overcurrent trips as they come, limit events are polled meanwhile.
+static void process_buttons_until(absolute_time_t until)
 {
-    if (!pressed) {
-        if (gpio == BUTTON_UP_PIN || gpio == BUTTON_DOWN_PIN) smps_memory_save();
-        return;
+    input_event_t event;
+    smps_trip_t trip;
+    while (!time_reached(until)) {
+        smps_pio_poll_limit_events();
+        if (easy_pwm_poll()) enable_all_relays(false);
+        if (smps_current_sensor_take_trip(&trip)) {
+            printf("trip at %lluus peak %.2fA\n", trip.time_us, trip.peak_amps);
+            smps_enter_alarm_mode();
+        }
+        else if (input_get_event(&event)) {
+            button_callback(event.key, event.type != INPUT_KEY_UP);
+        }
+        else {
+            absolute_time_t poll_time = make_timeout_time_ms(LIMIT_POLL_MS);
+            best_effort_wfe_or_timeout(absolute_time_min(poll_time, until));
+        }
     }
+}
+
+static void button_callback(uint gpio, bool pressed)
+{
+    if (!pressed) return;
 
     int hz_increment = 10;
     float duty_increment = 0.01;
@@ -112,8 +145,10 @@ static void button_callback(uint gpio, bool pressed)
             if (_smps_mode == SMPS_MODE_LIMIT && _smps_memory.amp_limit <= 
                 (CURRENT_SENSOR_MAX_AMPS - amp_increment))
                 _smps_memory.amp_limit += amp_increment;    
-            smps_display_repaint();
+            smps_current_sensor_update_limit();
             maybe_update_pwm_waveform();
+            smps_memory_save();
+            smps_display_repaint();
             break;
 
         case BUTTON_DOWN_PIN:
@@ -123,8 +158,10 @@ static void button_callback(uint gpio, bool pressed)
                 _smps_memory.pwm_duty -= duty_increment;
             if (_smps_mode == SMPS_MODE_LIMIT && _smps_memory.amp_limit >= amp_increment)
                 _smps_memory.amp_limit -= amp_increment;    
-            smps_display_repaint();
+            smps_current_sensor_update_limit();
             maybe_update_pwm_waveform();
+            smps_memory_save();
+            smps_display_repaint();
             break;
 
         case BUTTON_MODE_PIN:
@@ -136,10 +173,18 @@ static void button_callback(uint gpio, bool pressed)
     }
 }
 
+// Called on Core0 after the PWM was already cut by the trip.
 void smps_enter_alarm_mode()
 {
+    if (_smps_pwm_running) {
+        _smps_pwm_running = false;
+        easy_pwm_disable(PWM_PIN);
+        smps_memory_flush();
+    }
+
     enable_all_relays(false);
     _smps_alarm_occured = true;
+    smps_display_repaint();
 }
 
 static void enable_relay(uint relay_gpio, bool on)
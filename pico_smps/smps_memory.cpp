@@ -1,9 +1,13 @@
 
 #include "smps.h"
 #include "easy_eeprom.h"
+#include "persist.h"
 
 #define MEMORY_MAGIC 0xB000
 
+// settings are written only after they stay unchanged this long
+#define MEMORY_SAVE_IDLE_MS 2000
+
 static memory_t _default_memory = { 
     .magic = MEMORY_MAGIC, 
     .pwm_hz = 5000, 
@@ -13,6 +17,14 @@ static memory_t _default_memory = {
 
 memory_t _smps_memory;
 
+static const persist_eeprom_t _eeprom = {
+    .page_size = EEPROM_BYTESPERPAGE,
+    .read_bytes = easy_eeprom_read_bytes,
+    .write_page_async = easy_eeprom_write_page_async,
+    .is_busy = easy_eeprom_is_busy,
+    .take_error = easy_eeprom_take_error
+};
+
 void smps_memory_init()
 {
     easy_eeprom_init();
@@ -24,10 +36,19 @@ void smps_memory_restore()
     if (ret != sizeof(_smps_memory) || _smps_memory.magic != MEMORY_MAGIC) {
         _smps_memory = _default_memory;
     }
+
+    persist_init(&_eeprom, 0, &_smps_memory, sizeof(_smps_memory), MEMORY_SAVE_IDLE_MS);
 }
 
+// Marks the settings changed, the EEPROM write happens later in background.
 void smps_memory_save()
 {
-    easy_eeprom_write_bytes(0, (uint8_t *)&_smps_memory, sizeof(_smps_memory));
+    persist_mark_dirty();
+}
+
+// Starts writing the changed settings right now.
+void smps_memory_flush()
+{
+    persist_flush();
 }
 
@@ -2,17 +2,37 @@
 #include "smps.h"
 
 #include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
 
 #include "smps_repeater.pio.h"
 
-static void my_pio_irq_handler()
-{
-    // check if PIO0_IRQ_0=7 is set
-    if (pio_interrupt_get(pio0, 0)) {
-        _smps_limit_occured = true;
-        pio_interrupt_clear(pio0, 0);
-    }
-}
+// Limit event records are drained from the RX FIFO by DMA into a ring
+// and picked up by the main loop, so no IRQ is taken per event.
+// At 50K events per second the 4096 records last for 80ms.
+#define RING_WORDS 4096
+#define RING_BYTES (RING_WORDS * sizeof(uint32_t))
+#define RING_SIZE_BITS 14
+#define RING_TRANSFERS 0xffffffff
+
+// inter-event distances in pulses, bucket N holds [2^N, 2^(N+1))
+#define HISTOGRAM_BUCKETS 8
+
+static uint32_t _ring[RING_WORDS] __attribute__((aligned(RING_BYTES)));
+static uint _dma_channel;
+static uint _read_count = 0;
+static uint _written_base = 0;
+static uint16_t _last_pulse_counter = 0xffff;
+
+// Statistics accumulated between reports.
+static uint _events = 0;
+static uint _lost_records = 0;
+static uint64_t _suppressed_cycles = 0;
+static uint _histogram[HISTOGRAM_BUCKETS];
+static uint64_t _report_start_us = 0;
+
+static void start_dma_ring(PIO pio, uint sm);
+static uint get_written_count();
 
 void smps_pio_start_repeater()
 {
@@ -28,19 +48,106 @@ void smps_pio_start_repeater()
     gpio_init(LIMITER_INPUT_PIN);
     gpio_set_dir(LIMITER_INPUT_PIN, GPIO_IN);
     gpio_pull_down(LIMITER_INPUT_PIN);
-    
+
     gpio_init(LIMITER_OUTPUT_PIN);
     gpio_set_dir(LIMITER_OUTPUT_PIN, GPIO_OUT);
 
     smps_repeater_program_init(pio, sm, offset, LIMITER_FIRST_PIN);
 
-    // enable IRQ for the state machine
-    uint irq_num = PIO0_IRQ_0;
-    pio_set_irq0_source_enabled(pio, pis_interrupt0, true); 
-    irq_set_exclusive_handler(irq_num, my_pio_irq_handler);
-    irq_set_enabled(irq_num, true);
+    start_dma_ring(pio, sm);
+    _report_start_us = time_us_64();
 
-    // start the state machine 
+    // start the state machine
     pio_sm_set_enabled(pio, sm, true);
 }
 
+static void start_dma_ring(PIO pio, uint sm)
+{
+    _dma_channel = dma_claim_unused_channel(true);
+    dma_channel_config cfg = dma_channel_get_default_config(_dma_channel);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_ring(&cfg, true, RING_SIZE_BITS);
+    channel_config_set_dreq(&cfg, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(_dma_channel, &cfg, _ring, &pio->rxf[sm],
+        RING_TRANSFERS, true);
+}
+
+// Number of records written since the channel was started, modulo 2^32.
+// That is a multiple of the ring size, so count % RING_WORDS follows the
+// write address across the rearms.
+static uint get_written_count()
+{
+    return _written_base + RING_TRANSFERS - dma_channel_hw_addr(_dma_channel)->transfer_count;
+}
+
+// Takes new event records from the ring into the statistics,
+// returns the number of events seen.
+uint smps_pio_poll_limit_events()
+{
+    uint written = get_written_count();
+    uint count = written - _read_count;
+
+    // records older than the ring size are overwritten already
+    if (count > RING_WORDS) {
+        _lost_records += count - RING_WORDS;
+        _read_count = written - RING_WORDS;
+        count = RING_WORDS;
+    }
+
+    for (uint i = 0; i < count; i++) {
+        uint32_t record = _ring[_read_count % RING_WORDS];
+        _read_count += 1;
+
+        // both counters run down from 0xffff
+        uint16_t pulse_counter = (uint16_t)(record >> 16);
+        uint16_t pulses = _last_pulse_counter - pulse_counter;
+        _last_pulse_counter = pulse_counter;
+        uint suppressed = 0xffff - (record & 0xffff);
+        _suppressed_cycles += 2 * suppressed;
+
+        int bucket = 0;
+        while (bucket < HISTOGRAM_BUCKETS - 1 && (pulses >> (bucket + 1)) != 0) bucket++;
+        _histogram[bucket] += 1;
+    }
+
+    _events += count;
+
+    // rearm the channel after its 2^32 - 1 transfers are done, the write
+    // address runs on from where it stopped and so does the count
+    if (!dma_channel_is_busy(_dma_channel)) {
+        _written_base += RING_TRANSFERS;
+        dma_channel_set_trans_count(_dma_channel, RING_TRANSFERS, true);
+    }
+
+    if (count > 0) _smps_limit_occured = true;
+    return count;
+}
+
+// Prints event rate, the fraction of time the PWM was suppressed
+// and the histogram of the distances between events, then resets them.
+// Nothing is printed for an interval without events.
+void smps_pio_report_limit_stats()
+{
+    uint64_t now_us = time_us_64();
+    uint64_t elapsed_us = now_us - _report_start_us;
+    if (elapsed_us == 0) return;
+
+    uint64_t elapsed_cycles = elapsed_us * (clock_get_hz(clk_sys) / 1000000);
+    float lost_percent = 100.0f * _suppressed_cycles / elapsed_cycles;
+    float events_per_second = 1e6f * _events / elapsed_us;
+
+    if (_events > 0 || _lost_records > 0) {
+        printf("limit: %.0f ev/s lost %.2f%% dropped %d hist",
+            events_per_second, lost_percent, _lost_records);
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) printf(" %d", _histogram[i]);
+        printf("\n");
+    }
+
+    _events = 0;
+    _lost_records = 0;
+    _suppressed_cycles = 0;
+    memset(_histogram, 0, sizeof(_histogram));
+    _report_start_us = now_us;
+}